@@ -0,0 +1,108 @@
+#include <BadAccessGuards.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// Detections per CPU second of a racy workload, with and without `BAD_ACCESS_GUARDS_AMPLIFY`.
+// This file is built once per value of `BAD_ACCESS_GUARDS_AMPLIFY` along with its own copy of BadAccessGuards.cpp, since the value must be the same everywhere.
+// Each thread mostly writes its own objects (quiet sites), and once in a while writes a shared object without any lock (racy site).
+// Not a nanobench benchmark: what matters is how many races are caught for the CPU time spent, not the time per operation.
+
+#ifdef NDEBUG
+const auto runDuration = std::chrono::milliseconds(1000);
+#else
+const auto runDuration = std::chrono::milliseconds(300);
+#endif
+const int racyWriteOneIn = 64;
+
+struct Counter
+{
+    uint64_t value = 0;
+    BA_GUARD_DECL(BAShadow);
+
+    void QuietIncrement() { BA_GUARD_WRITE(BAShadow); value++; }
+    void RacyIncrement() { BA_GUARD_WRITE(BAShadow); value++; }
+};
+
+std::atomic<uint64_t> gNbDetections{ 0 };
+
+bool CountBadAccess(StateAndStackAddr, BadAccessGuardState, const BadAccessGuardSite&, const BadAccessGuardBacktrace&)
+{
+    gNbDetections.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Run(const char* name)
+{
+    const int nbThreads = int(std::min(std::max(std::thread::hardware_concurrency(), 2u), 8u));
+    std::vector<Counter> ownCounters(size_t(nbThreads) * 8); // Padding between threads
+    Counter shared;
+    std::atomic<bool> stop{ false };
+    uint64_t nbWrites = 0;
+    std::atomic<uint64_t> totalWrites{ 0 };
+
+    gNbDetections = 0;
+    const std::clock_t cpuStart = std::clock();
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < nbThreads; thread++)
+    {
+        threads.emplace_back([&, thread] {
+            Counter& own = ownCounters[size_t(thread) * 8];
+            uint64_t nbThreadWrites = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (int i = 1; i < racyWriteOneIn; i++) own.QuietIncrement();
+                shared.RacyIncrement();
+                nbThreadWrites += racyWriteOneIn;
+            }
+            totalWrites += nbThreadWrites;
+        });
+    }
+    std::this_thread::sleep_for(runDuration);
+    stop = true;
+    for (std::thread& thread : threads) thread.join();
+    const double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    nbWrites = totalWrites;
+
+    const uint64_t nbDetections = gNbDetections;
+    printf("| %-28s | %7d | %12llu | %10llu | %8.3f | %14.1f |\n", name, nbThreads, (unsigned long long)nbWrites, (unsigned long long)nbDetections, cpuSeconds, cpuSeconds > 0 ? double(nbDetections) / cpuSeconds : 0.);
+}
+
+int main()
+{
+    BadAccessGuardConfig config = BadAccessGuardGetConfig();
+    config.allowBreak = false;
+    config.reportBadAccess = CountBadAccess;
+    BadAccessGuardSetConfig(config);
+
+    printf("| %-28s | %7s | %12s | %10s | %8s | %14s |\n", "mode", "threads", "writes", "detections", "CPU (s)", "detections/CPU s");
+    printf("|------------------------------|---------|--------------|------------|----------|----------------|\n");
+#if BAD_ACCESS_GUARDS_AMPLIFY
+    struct Mode
+    {
+        const char* name;
+        BadAccessGuardAmplifyConfig config;
+    };
+    const Mode modes[] = {
+        { "amplify off", { BAGuardAmplify_Off, 0, 0.f } },
+        { "spin 2us, budget 25%", { BAGuardAmplify_Spin, 2000, 0.25f } },
+        { "spin 20us, budget 25%", { BAGuardAmplify_Spin, 20000, 0.25f } },
+        { "yield 2us, budget 25%", { BAGuardAmplify_Yield, 2000, 0.25f } },
+        { "sleep 20us, budget 25%", { BAGuardAmplify_Sleep, 20000, 0.25f } },
+        { "spin 2us, budget 100%", { BAGuardAmplify_Spin, 2000, 1.f } },
+    };
+    for (const Mode& mode : modes)
+    {
+        BadAccessGuardSetAmplifyConfig(mode.config);
+        Run(mode.name);
+    }
+#else
+    Run("normal");
+#endif
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <BadAccessGuards.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <string>
+#include <vector>
+
+// Throughput of BadAccessGuardAuditShadows over an arena of idle objects, in objects per nanosecond (nanobench prints ns/object, invert it).
+// This file is built once with the default SIMD selection, once with BA_GUARD_AUDIT_SIMD=0 (scalar) and once with -mavx2 (x86 GCC/clang),
+// each with its own copy of BadAccessGuards.cpp. Compare the outputs of the executables.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#ifdef NDEBUG
+const size_t nbObjects = 1'000'000;
+#else
+const size_t nbObjects = 100'000;
+#endif
+
+#ifndef BA_GUARD_AUDIT_SIMD
+# define BA_GUARD_AUDIT_SIMD 1
+#endif
+#define BA_GUARD_STRINGIFY_(x) #x
+#define BA_GUARD_STRINGIFY(x) BA_GUARD_STRINGIFY_(x)
+
+template<size_t Size>
+struct Object
+{
+    BA_GUARD_DECL(BAShadow);
+    char payload[Size - sizeof(BadAccessGuardShadow)];
+};
+
+template<size_t Size>
+void BenchArena(ankerl::nanobench::Bench& bench)
+{
+    std::vector<Object<Size>> arena(nbObjects);
+    bench.run(std::to_string(Size) + " bytes objects", [&] {
+        ankerl::nanobench::doNotOptimizeAway(BadAccessGuardAuditShadows(&arena[0].BAShadow, sizeof(Object<Size>), arena.size(), nullptr, 0));
+    });
+}
+
+int main()
+{
+    ankerl::nanobench::Bench bench;
+    bench.title("Audit, BA_GUARD_AUDIT_SIMD=" BA_GUARD_STRINGIFY(BA_GUARD_AUDIT_SIMD) " " BENCH_AUDIT_ISA).unit("object").relative(true);
+    bench.batch(nbObjects).minEpochTime(minEpoch);
+
+    // 8 bytes is a dense array of shadows, as a side table would be
+    BenchArena<8>(bench);
+    BenchArena<16>(bench);
+    BenchArena<64>(bench);
+
+    // Every object is offending, so that every block is rescanned and every index recorded
+    std::vector<Object<16>> writing(nbObjects);
+    for (Object<16>& object : writing) object.BAShadow.SetStateAtomicRelaxed(BAGuard_Writing);
+    std::vector<size_t> indices(nbObjects);
+    bench.run("16 bytes objects, all writing", [&] {
+        ankerl::nanobench::doNotOptimizeAway(BadAccessGuardAuditShadows(&writing[0].BAShadow, sizeof(Object<16>), writing.size(), indices.data(), indices.size()));
+    });
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <BadAccessGuards.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#if defined(__GLIBC__)
+# include <execinfo.h>
+# define HAS_GLIBC_BACKTRACE 1
+#else
+# define HAS_GLIBC_BACKTRACE 0
+#endif
+
+#if defined(_MSC_VER)
+# define BENCH_NO_INLINE __declspec(noinline)
+#else
+# define BENCH_NO_INLINE __attribute__((noinline))
+#endif
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+constexpr int maxFrames = 64;
+using CaptureFunction = int(void** frames, int maxFrames);
+
+// Recurse to get a callstack of (at least) `depth` frames before capturing, as the slow path would from deep inside your code.
+BENCH_NO_INLINE int CaptureAtDepth(int depth, CaptureFunction* capture, void** frames)
+{
+    if (depth > 0)
+    {
+        const int count = CaptureAtDepth(depth - 1, capture, frames);
+        ankerl::nanobench::doNotOptimizeAway(depth); // Prevent tail call optimization, which would remove our frames
+        return count;
+    }
+    return capture(frames, maxFrames);
+}
+
+int CaptureFramePointers(void** frames, int maxFrames) { return BadAccessGuardCaptureBacktrace(frames, maxFrames, 0); }
+#if HAS_GLIBC_BACKTRACE
+int CaptureGlibc(void** frames, int maxFrames) { return backtrace(frames, maxFrames); }
+#endif
+
+int main()
+{
+#if BAD_ACCESS_GUARDS_ENABLE
+    void* frames[maxFrames];
+#if HAS_GLIBC_BACKTRACE
+    CaptureGlibc(frames, maxFrames); // First call loads libgcc_s, don't measure it
+#endif
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Backtrace capture").relative(true);
+    for (int depth : { 8, 32, 128 })
+    {
+        int count = 0;
+        bench.complexityN(depth)
+            .minEpochTime(minEpoch)
+            .run("BadAccessGuardCaptureBacktrace", [&] {
+                count = CaptureAtDepth(depth, CaptureFramePointers, frames);
+                ankerl::nanobench::doNotOptimizeAway(count);
+            });
+#if HAS_GLIBC_BACKTRACE
+        bench.complexityN(depth)
+            .minEpochTime(minEpoch)
+            .run("glibc backtrace()", [&] {
+                count = CaptureAtDepth(depth, CaptureGlibc, frames);
+                ankerl::nanobench::doNotOptimizeAway(count);
+            });
+#endif
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
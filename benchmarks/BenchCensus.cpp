@@ -0,0 +1,68 @@
+#include "../examples/GuardedVectorExample.h"
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <thread>
+#include <vector>
+
+// Overhead of the census on write guards. This file is built once per value of `BAD_ACCESS_GUARDS_CENSUS` (0 meaning disabled)
+// along with its own copy of BadAccessGuards.cpp, since the value must be the same everywhere. Compare the outputs of the executables.
+// - push_back: a single thread, so only the fast path check.
+// - handoff: every write sees a previous write from another thread, so the (sampled) slow path is taken each time.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#ifdef NDEBUG
+const size_t nbElementsPerIteration = 100'000;
+#else
+const size_t nbElementsPerIteration = 1'000;
+#endif
+const size_t nbObjects = 64;
+
+#define BA_GUARD_STRINGIFY_(x) #x
+#define BA_GUARD_STRINGIFY(x) BA_GUARD_STRINGIFY_(x)
+
+struct GuardedCounter
+{
+    uint64_t value = 0;
+    BA_GUARD_DECL(BAShadow);
+    BA_GUARD_NO_INLINE void Add(uint64_t amount) { BA_GUARD_WRITE(BAShadow); value += amount; }
+};
+
+int main()
+{
+    ankerl::nanobench::Bench bench;
+    bench.title("Census N=" BA_GUARD_STRINGIFY(BAD_ACCESS_GUARDS_CENSUS)).relative(true);
+    bench.complexityN(nbElementsPerIteration).batch(nbElementsPerIteration).minEpochTime(minEpoch);
+
+    bench.run("guardedvector push_back", [&] {
+        ExampleGuardedVector<uint64_t> vec;
+        vec.reserve(nbElementsPerIteration);
+        for (size_t i = 0; i < nbElementsPerIteration; i++) vec.push_back(i);
+        ankerl::nanobench::doNotOptimizeAway(vec.data());
+    });
+
+    // Capture the value a write from another thread leaves in the shadow, and put it back before each write.
+    GuardedCounter counters[nbObjects];
+    StateAndStackAddr otherThreadValue = 0;
+    std::thread([&] { counters[0].Add(1); otherThreadValue = counters[0].BAShadow.stateAndInStackAddr; }).join();
+
+    bench.run("write, same thread", [&] {
+        for (size_t i = 0; i < nbElementsPerIteration; i++)
+        {
+            GuardedCounter& counter = counters[i % nbObjects];
+            counter.Add(1);
+        }
+    });
+    bench.run("write, handoff from another thread", [&] {
+        for (size_t i = 0; i < nbElementsPerIteration; i++)
+        {
+            GuardedCounter& counter = counters[i % nbObjects];
+            counter.BAShadow.stateAndInStackAddr = otherThreadValue;
+            counter.Add(1);
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "../examples/GuardedVectorExample.h"
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// Overhead of the options that must have the same value for all the code using guards.
+// This file is built once per value along with its own copy of BadAccessGuards.cpp, compare the outputs of the executables of the same option:
+// - BenchFlightRecorder0/64/1024: `BAD_ACCESS_GUARDS_FLIGHT_RECORDER`, recording guard operations, and merging/printing the rings when a bad access is detected.
+// - BenchSdtProbes0/1: `BAD_ACCESS_GUARDS_SDT_PROBES`. Without a tracer each probe is a `nop`, run BenchSdtProbes1 under perf/bpftrace to measure attached probes (see Benchmarks.md).
+// - BenchWriteStack0/16: `BAD_ACCESS_GUARDS_WRITE_STACK`, pushing/popping write guards, printing the stack on detection, and the leaked writes check at thread exit.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#ifdef NDEBUG
+const size_t nbElementsPerIteration = 100'000;
+#else
+const size_t nbElementsPerIteration = 1'000;
+#endif
+
+#define BA_GUARD_STRINGIFY_(x) #x
+#define BA_GUARD_STRINGIFY(x) BA_GUARD_STRINGIFY_(x)
+
+// Writes nested in the write of an outer object, as when updating the members of a guarded aggregate.
+struct Outer
+{
+    ExampleGuardedVector<uint64_t> values;
+    BA_GUARD_DECL(BAShadow);
+
+    void Append(uint64_t value)
+    {
+        BA_GUARD_WRITE(BAShadow);
+        values.push_back(value);
+    }
+};
+
+struct Object
+{
+    BA_GUARD_DECL(BAShadow);
+};
+
+static bool IgnoreBadAccess(StateAndStackAddr, BadAccessGuardState, const BadAccessGuardSite&, const BadAccessGuardBacktrace&) { return false; }
+
+const char* const title = "Flight recorder K=" BA_GUARD_STRINGIFY(BAD_ACCESS_GUARDS_FLIGHT_RECORDER)
+    ", SDT probes=" BA_GUARD_STRINGIFY(BAD_ACCESS_GUARDS_SDT_PROBES)
+    ", write stack D=" BA_GUARD_STRINGIFY(BAD_ACCESS_GUARDS_WRITE_STACK);
+
+int main()
+{
+    ankerl::nanobench::Bench bench;
+    bench.title(title).relative(true);
+    bench.complexityN(nbElementsPerIteration).batch(nbElementsPerIteration).minEpochTime(minEpoch);
+
+    bench.run("std::vector push_back", [&] {
+        std::vector<uint64_t> vec;
+        vec.reserve(nbElementsPerIteration);
+        for (size_t i = 0; i < nbElementsPerIteration; i++) vec.push_back(i);
+        ankerl::nanobench::doNotOptimizeAway(vec.data());
+    });
+    bench.run("guardedvector push_back", [&] {
+        ExampleGuardedVector<uint64_t> vec;
+        vec.reserve(nbElementsPerIteration);
+        for (size_t i = 0; i < nbElementsPerIteration; i++) vec.push_back(i);
+        ankerl::nanobench::doNotOptimizeAway(vec.data());
+    });
+    bench.run("nested guardedvector push_back", [&] {
+        Outer outer;
+        outer.values.reserve(nbElementsPerIteration);
+        for (size_t i = 0; i < nbElementsPerIteration; i++) outer.Append(i);
+        ankerl::nanobench::doNotOptimizeAway(outer.values.data());
+    });
+
+    std::vector<uint64_t> vector(nbElementsPerIteration, 1);
+    ExampleGuardedVector<uint64_t> guardedvector;
+    for (size_t i = 0; i < nbElementsPerIteration; i++) guardedvector.push_back(1);
+
+    uint64_t x = 0;
+    bench.run("std::vector operator[]", [&] {
+        for (size_t i = 0; i < nbElementsPerIteration; i++) x += vector[i];
+        ankerl::nanobench::doNotOptimizeAway(x);
+    });
+    bench.run("guardedvector operator[]", [&] {
+        for (size_t i = 0; i < nbElementsPerIteration; i++) x += guardedvector[i];
+        ankerl::nanobench::doNotOptimizeAway(x);
+    });
+
+    // Per thread costs: first use of the flight recorder ring or of the write stack, and the leaked writes check when the thread exits.
+    ankerl::nanobench::Bench threadBench;
+    threadBench.title(title).relative(true).minEpochTime(minEpoch);
+    threadBench.run("thread start/join", [&] {
+        std::thread thread([] {});
+        thread.join();
+    });
+    threadBench.run("thread start/join, one write", [&] {
+        std::thread thread([] {
+            Object object;
+            BA_GUARD_WRITE(object.BAShadow);
+        });
+        thread.join();
+    });
+
+    // Last, since reports are silenced from here on. The report callback does nothing, but the slow path still captures the backtrace
+    // and prints the flight recorder and the write stack (nested in a write) if they are enabled.
+    printf("Silencing reports for the slow path benchmark.\n");
+    fflush(stdout);
+#ifdef _WIN32
+    (void)freopen("NUL", "w", stderr);
+#else
+    (void)freopen("/dev/null", "w", stderr);
+#endif
+    BadAccessGuardConfig config = BadAccessGuardGetConfig();
+    config.allowBreak = false;
+    config.reportBadAccess = IgnoreBadAccess;
+    BadAccessGuardSetConfig(config);
+
+    Object outer;
+    Object object;
+    for (size_t i = 0; i < 1024; i++) guardedvector[i % nbElementsPerIteration]; // Fill the flight recorder ring of this thread
+    ankerl::nanobench::Bench slowPathBench;
+    slowPathBench.title(title).minEpochTime(minEpoch);
+    slowPathBench.run("bad access detected", [&] {
+        BA_GUARD_WRITE(outer.BAShadow);
+        BA_GUARD_WRITE(object.BAShadow);
+        BA_GUARD_READ(object.BAShadow); // Read during write
+    });
+    return 0;
+}
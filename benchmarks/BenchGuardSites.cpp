@@ -0,0 +1,97 @@
+#include <BadAccessGuards.h>
+
+#include <nanobench.h>
+#include <chrono>
+#include <stdio.h>
+
+#include <vector>
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#if BAD_ACCESS_GUARDS_ENABLE
+
+#if defined(_MSC_VER)
+# define BENCH_NO_INLINE __declspec(noinline)
+#else
+# define BENCH_NO_INLINE __attribute__((noinline))
+#endif
+
+static char gExMessage[] = "SiteVector was modified concurrently";
+
+// Same operation guarded three ways, so that only the guard differs.
+// The push_back functions are not inlined on purpose: compare their size with `nm --size-sort -C BenchGuardSites | grep SiteVector`.
+struct SiteVector
+{
+    std::vector<uint64_t> storage;
+    BA_GUARD_DECL(shadow);
+
+    BENCH_NO_INLINE void push_back(uint64_t value)
+    {
+        BA_GUARD_WRITE(shadow);
+        storage.push_back(value);
+    }
+    BENCH_NO_INLINE void push_back_ex(uint64_t value)
+    {
+        BA_GUARD_WRITE_EX(shadow, true, gExMessage);
+        storage.push_back(value);
+    }
+    BENCH_NO_INLINE void push_back_site(uint64_t value)
+    {
+        BA_GUARD_WRITE_SITE(shadow, SiteVector, true, "SiteVector was modified concurrently");
+        storage.push_back(value);
+    }
+    BENCH_NO_INLINE size_t size() const
+    {
+        BA_GUARD_READ(shadow);
+        return storage.size();
+    }
+    BENCH_NO_INLINE size_t size_ex() const
+    {
+        BA_GUARD_READ_EX(shadow, true, gExMessage);
+        return storage.size();
+    }
+    BENCH_NO_INLINE size_t size_site() const
+    {
+        BA_GUARD_READ_SITE(shadow, SiteVector, true, "SiteVector was read concurrently");
+        return storage.size();
+    }
+};
+
+template<typename PushBack, typename Size>
+void BenchSite(ankerl::nanobench::Bench& bench, const char* name, PushBack pushBack, Size sizeFn)
+{
+    const size_t nbPushBacks = 1'000;
+    SiteVector vector;
+    vector.storage.reserve(nbPushBacks);
+    uint64_t x = 1;
+    bench.complexityN(nbPushBacks)
+        .minEpochTime(minEpoch)
+        .run(name, [&] {
+            for (size_t i = 0; i < nbPushBacks; i++)
+            {
+                (vector.*pushBack)(x);
+                x += (vector.*sizeFn)();
+            }
+            ankerl::nanobench::doNotOptimizeAway(x);
+            vector.storage.clear();
+        });
+}
+
+int main()
+{
+    printf("sizeof(BadAccessGuardWrite)=%zu sizeof(BadAccessGuardWriteEx)=%zu sizeof(BadAccessGuardWriteSite<>)=%zu\n",
+        sizeof(BadAccessGuardWrite), sizeof(BadAccessGuardWriteEx), sizeof(BadAccessGuardWriteSite<void>));
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Ex guards vs static site descriptors").relative(true);
+    // Plain guards have no message nor site at all, they are the reference.
+    BenchSite(bench, "BA_GUARD_WRITE + BA_GUARD_READ", &SiteVector::push_back, &SiteVector::size);
+    BenchSite(bench, "BA_GUARD_WRITE_EX + BA_GUARD_READ_EX", &SiteVector::push_back_ex, &SiteVector::size_ex);
+    BenchSite(bench, "BA_GUARD_WRITE_SITE + BA_GUARD_READ_SITE", &SiteVector::push_back_site, &SiteVector::size_site);
+    return 0;
+}
+
+#else
+int main() { return 1; }
+#endif
@@ -0,0 +1,114 @@
+#include <BadAccessGuardedAllocators.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <vector>
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+// Same algorithms as BadAccessGuardedArena/BadAccessGuardedPool without the guards.
+// We can't just include the header with BAD_ACCESS_GUARDS_ENABLE=0 in another file, it would break the one definition rule.
+class UnguardedArena
+{
+    char* const begin;
+    char* const end;
+    char* current;
+public:
+    UnguardedArena(void* buffer, size_t size) : begin(static_cast<char*>(buffer)), end(begin + size), current(begin) {}
+    void* Allocate(size_t size, size_t alignment = alignof(max_align_t))
+    {
+        const uintptr_t aligned = (uintptr_t(current) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (aligned > uintptr_t(end) || size > uintptr_t(end) - aligned) return nullptr;
+        current = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+    void Reset() { current = begin; }
+};
+
+class UnguardedPool
+{
+    struct FreeBlock { FreeBlock* next; };
+    char* const begin;
+    char* const end;
+    const size_t blockSize;
+    char* untouched;
+    FreeBlock* freeList;
+public:
+    UnguardedPool(void* buffer, size_t bufferSize, size_t blockSize)
+        : begin(static_cast<char*>(buffer)), end(begin + bufferSize / blockSize * blockSize), blockSize(blockSize), untouched(begin), freeList(nullptr) {}
+    void* Allocate()
+    {
+        if (FreeBlock* block = freeList) { freeList = block->next; return block; }
+        if (untouched == end) return nullptr;
+        void* block = untouched;
+        untouched += blockSize;
+        return block;
+    }
+    void Free(void* ptr)
+    {
+        if (!ptr) return;
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = freeList;
+        freeList = block;
+    }
+    void Reset() { untouched = begin; freeList = nullptr; }
+};
+
+#ifdef NDEBUG
+const size_t nbAllocations = 100'000;
+#else
+const size_t nbAllocations = 1'000;
+#endif
+const size_t allocationSize = 32;
+
+template<typename Arena>
+void BenchArena(ankerl::nanobench::Bench& bench, const char* name, std::vector<char>& buffer)
+{
+    Arena arena(buffer.data(), buffer.size());
+    bench.batch(nbAllocations)
+        .minEpochTime(minEpoch)
+        .run(name, [&] {
+            for (size_t i = 0; i < nbAllocations; i++)
+            {
+                ankerl::nanobench::doNotOptimizeAway(arena.Allocate(allocationSize, 8));
+            }
+            arena.Reset();
+        });
+}
+
+template<typename Pool>
+void BenchPool(ankerl::nanobench::Bench& bench, const char* name, std::vector<char>& buffer)
+{
+    Pool pool(buffer.data(), buffer.size(), allocationSize);
+    std::vector<void*> blocks(nbAllocations);
+    // Allocate everything (bump path), then free and allocate everything again (freelist path)
+    bench.batch(nbAllocations * 2)
+        .minEpochTime(minEpoch)
+        .run(name, [&] {
+            for (size_t i = 0; i < nbAllocations; i++) blocks[i] = pool.Allocate();
+            for (size_t i = 0; i < nbAllocations; i++) pool.Free(blocks[i]);
+            for (size_t i = 0; i < nbAllocations; i++) blocks[i] = pool.Allocate();
+            ankerl::nanobench::doNotOptimizeAway(blocks.data());
+            pool.Reset();
+        });
+}
+
+int main()
+{
+    std::vector<char> buffer(nbAllocations * allocationSize);
+    {
+        ankerl::nanobench::Bench bench;
+        bench.title("Arena").unit("allocation").relative(true);
+        BenchArena<UnguardedArena>(bench, "UnguardedArena.Allocate", buffer);
+        BenchArena<BadAccessGuardedArena>(bench, "BadAccessGuardedArena.Allocate", buffer);
+    }
+    {
+        ankerl::nanobench::Bench bench;
+        bench.title("Pool").unit("allocation").relative(true);
+        BenchPool<UnguardedPool>(bench, "UnguardedPool.Allocate/Free", buffer);
+        BenchPool<BadAccessGuardedPool>(bench, "BadAccessGuardedPool.Allocate/Free", buffer);
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+#include "../examples/GuardedVectorExample.h"
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+
+// Read path benchmarks: `operator[]`, `size()`, `data()` and `begin()`/`end()` use the read guard, which is the most common one.
+//
+// Usage: BenchGuardedVectorReads [--json results.json] [--baseline baseline.json] [--tolerance percentagePoints]
+// - `--json` writes the results, including the overhead of the guarded vector compared to `std::vector`.
+// - `--baseline` compares the overheads with a previous `--json` output, and returns 1 if one of them regressed more than `--tolerance` (default 10).
+// We compare overheads rather than timings so that a baseline stays meaningful across runs and, to some extent, machines.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#ifdef NDEBUG
+static const char* const buildConfig = "Release";
+const size_t nbElementsPerIteration[] = { 1'000, 100'000 };
+#else
+static const char* const buildConfig = "Debug";
+const size_t nbElementsPerIteration[] = { 1'000 };
+#endif
+
+struct Payload16B {
+    Payload16B(uint64_t v = 0) : storage{ v, v } {}
+    uint64_t storage[2];
+};
+struct PayloadString {
+    PayloadString(uint64_t v = 0) { storage += char(v); }
+    std::string storage;
+};
+static uint64_t Value(uint64_t v) { return v; }
+static uint64_t Value(const Payload16B& v) { return v.storage[0]; }
+static uint64_t Value(const PayloadString& v) { return v.storage.size(); }
+
+struct BenchRecord
+{
+    std::string title;
+    std::string name;
+    double complexityN;
+    double nsPerOp;
+    double overhead; // Guarded ns/op divided by std::vector ns/op, minus 1. 0 for std::vector itself.
+};
+static std::vector<BenchRecord> gRecords;
+
+static double LastNsPerOp(const ankerl::nanobench::Bench& bench)
+{
+    const ankerl::nanobench::Result& result = bench.results().back();
+    return result.median(ankerl::nanobench::Result::Measure::elapsed) / result.config().mBatch * 1e9;
+}
+
+// Runs the same operation on std::vector and ExampleGuardedVector, and records the overhead of the guards.
+// `frozen`: the guarded vector is frozen once filled, reads should cost the same.
+template<typename T, typename Op>
+void BenchPair(ankerl::nanobench::Bench& bench, const std::string& opName, size_t size, Op op, bool frozen = false)
+{
+    std::vector<T> vector;
+    ExampleGuardedVector<T> guardedvector;
+    for (size_t i = 0; i < size; i++)
+    {
+        vector.push_back(T{ i });
+        guardedvector.push_back(T{ i });
+    }
+    if (frozen) guardedvector.freeze();
+
+    uint64_t x = 0;
+    bench.complexityN(size).batch(size).minEpochTime(minEpoch);
+    bench.run("std::vector " + opName, [&] { op(vector, x); ankerl::nanobench::doNotOptimizeAway(x); });
+    const double vectorNs = LastNsPerOp(bench);
+    gRecords.push_back({ bench.results().back().config().mBenchmarkTitle, "std::vector " + opName, double(size), vectorNs, 0. });
+
+#if BAD_ACCESS_GUARDS_ENABLE
+    bench.run("guardedvector " + opName, [&] { op(guardedvector, x); ankerl::nanobench::doNotOptimizeAway(x); });
+    const double guardedNs = LastNsPerOp(bench);
+    gRecords.push_back({ bench.results().back().config().mBenchmarkTitle, "guardedvector " + opName, double(size), guardedNs, guardedNs / vectorNs - 1. });
+#endif
+}
+
+template<typename T>
+void BenchReads(const char* title)
+{
+    ankerl::nanobench::Bench bench;
+    bench.title(title).relative(true);
+
+    for (size_t size : nbElementsPerIteration)
+    {
+        // Precomputed so that we don't measure the random number generator
+        std::vector<size_t> randomIndices(size);
+        uint64_t rng = 0x9E3779B97F4A7C15ull;
+        for (size_t& index : randomIndices)
+        {
+            rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17; // xorshift64
+            index = size_t(rng % size);
+        }
+
+        BenchPair<T>(bench, "operator[] random", size, [&](auto& vec, uint64_t& x) {
+            for (size_t index : randomIndices) x += Value(vec[index]);
+        });
+        BenchPair<T>(bench, "begin/end iteration", size, [&](auto& vec, uint64_t& x) {
+            for (const T& elem : vec) x += Value(elem);
+        });
+        BenchPair<T>(bench, "size() + operator[]", size, [&](auto& vec, uint64_t& x) {
+            for (size_t i = 0; i < vec.size(); i++) x += Value(vec[i]);
+        });
+        BenchPair<T>(bench, "data()", size, [&](auto& vec, uint64_t& x) {
+            for (size_t i = 0; i < size; i++) x += Value(vec.data()[i]);
+        });
+        BenchPair<T>(bench, "operator[] random, frozen", size, [&](auto& vec, uint64_t& x) {
+            for (size_t index : randomIndices) x += Value(vec[index]);
+        }, true);
+        BenchPair<T>(bench, "size() + operator[], frozen", size, [&](auto& vec, uint64_t& x) {
+            for (size_t i = 0; i < vec.size(); i++) x += Value(vec[i]);
+        }, true);
+        // Writes are push_backs, the size is restored afterwards so that each iteration sees the same vector.
+        for (int writesPer100 : { 10, 50 })
+        {
+            BenchPair<T>(bench, "mixed " + std::to_string(100 - writesPer100) + "% reads / " + std::to_string(writesPer100) + "% writes", size, [&, writesPer100](auto& vec, uint64_t& x) {
+                for (size_t i = 0; i < size; i++)
+                {
+                    if (int(i % 100) < writesPer100) vec.push_back(T{ x });
+                    else x += Value(vec[randomIndices[i]]);
+                }
+                vec.resize(size);
+            });
+        }
+    }
+}
+
+static void WriteJson(const char* path)
+{
+    std::ofstream out(path);
+    // One result per line, so that the baseline can be read back without a JSON parser.
+    out << "{\n  \"config\": \"" << buildConfig << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < gRecords.size(); i++)
+    {
+        const BenchRecord& record = gRecords[i];
+        char numbers[128];
+        snprintf(numbers, sizeof(numbers), "\"complexityN\": %.0f, \"nsPerOp\": %.6f, \"overhead\": %.6f", record.complexityN, record.nsPerOp, record.overhead);
+        out << "    { \"title\": \"" << record.title << "\", \"name\": \"" << record.name << "\", " << numbers << " }" << (i + 1 < gRecords.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static bool ReadJsonString(const std::string& line, const char* key, std::string& value)
+{
+    const std::string pattern = std::string("\"") + key + "\": \"";
+    const size_t start = line.find(pattern);
+    if (start == std::string::npos) return false;
+    const size_t valueStart = start + pattern.size();
+    const size_t end = line.find('"', valueStart);
+    if (end == std::string::npos) return false;
+    value = line.substr(valueStart, end - valueStart);
+    return true;
+}
+
+static bool ReadJsonNumber(const std::string& line, const char* key, double& value)
+{
+    const std::string pattern = std::string("\"") + key + "\": ";
+    const size_t start = line.find(pattern);
+    if (start == std::string::npos) return false;
+    value = strtod(line.c_str() + start + pattern.size(), nullptr);
+    return true;
+}
+
+// Exit codes of the benchmark. Nothing is run if the arguments are invalid.
+enum BaselineResult
+{
+    Baseline_Ok = 0,
+    Baseline_Regressions = 1,
+    Baseline_InvalidArguments = 2,
+    Baseline_Unreadable = 3,
+    Baseline_ConfigMismatch = 4,
+};
+
+// Nothing is compared if the baseline can not be read or was recorded with another build configuration.
+static BaselineResult CompareWithBaseline(const char* path, double tolerancePercent)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        fprintf(stderr, "Could not open baseline %s\n", path);
+        return Baseline_Unreadable;
+    }
+
+    // The config comes before the results, see WriteJson
+    std::string line;
+    std::string config;
+    while (std::getline(in, line) && !ReadJsonString(line, "config", config)) {}
+    if (config.empty())
+    {
+        fprintf(stderr, "Baseline %s has no build configuration, it was not written by this benchmark.\n", path);
+        return Baseline_Unreadable;
+    }
+    if (config != buildConfig)
+    {
+        fprintf(stderr, "Baseline %s was recorded with a %s build, this is a %s build. Nothing was compared.\n", path, config.c_str(), buildConfig);
+        return Baseline_ConfigMismatch;
+    }
+
+    int nbBaselineRecords = 0;
+    int nbRegressions = 0;
+    printf("\n| %-30s | %-50s | %11s | %17s | %16s |\n", "title", "name", "complexityN", "baseline overhead", "current overhead");
+    while (std::getline(in, line))
+    {
+        BenchRecord baseline;
+        if (!ReadJsonString(line, "title", baseline.title) || !ReadJsonString(line, "name", baseline.name)
+            || !ReadJsonNumber(line, "complexityN", baseline.complexityN) || !ReadJsonNumber(line, "overhead", baseline.overhead))
+        {
+            continue;
+        }
+        nbBaselineRecords++;
+        for (const BenchRecord& record : gRecords)
+        {
+            if (record.title != baseline.title || record.name != baseline.name || record.complexityN != baseline.complexityN) continue;
+            const bool regressed = (record.overhead - baseline.overhead) * 100. > tolerancePercent;
+            nbRegressions += regressed ? 1 : 0;
+            printf("| %-30s | %-50s | %11.0f | %16.1f%% | %15.1f%% |%s\n", record.title.c_str(), record.name.c_str(), record.complexityN,
+                baseline.overhead * 100., record.overhead * 100., regressed ? " REGRESSION" : "");
+        }
+    }
+    if (nbBaselineRecords == 0)
+    {
+        fprintf(stderr, "Baseline %s has no results.\n", path);
+        return Baseline_Unreadable;
+    }
+    if (nbRegressions != 0)
+    {
+        fprintf(stderr, "%d regression(s) compared to baseline %s\n", nbRegressions, path);
+        return Baseline_Regressions;
+    }
+    return Baseline_Ok;
+}
+
+int main(int argc, char** argv)
+{
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double tolerancePercent = 10.;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const char* error = nullptr;
+        if (strcmp(option, "--json") && strcmp(option, "--baseline") && strcmp(option, "--tolerance")) error = "Unknown argument";
+        else if (!value) error = "Missing value for";
+        else if (!strcmp(option, "--json")) jsonPath = value;
+        else if (!strcmp(option, "--baseline")) baselinePath = value;
+        else
+        {
+            char* valueEnd = nullptr;
+            tolerancePercent = strtod(value, &valueEnd);
+            if (valueEnd == value || *valueEnd != '\0') error = "Invalid value for";
+        }
+        if (error)
+        {
+            fprintf(stderr, "%s %s\nUsage: %s [--json results.json] [--baseline baseline.json] [--tolerance percentagePoints]\n", error, option, argv[0]);
+            return Baseline_InvalidArguments;
+        }
+    }
+
+    BenchReads<uint64_t>("Reads - Vector of uint64_t");
+    BenchReads<Payload16B>("Reads - Vector of uint64_t*2");
+    BenchReads<PayloadString>("Reads - Vector of std::string");
+
+    if (jsonPath)
+    {
+        WriteJson(jsonPath);
+    }
+    if (baselinePath)
+    {
+        return CompareWithBaseline(baselinePath, tolerancePercent);
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <BadAccessGuarded.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <stdint.h>
+
+// BadAccessGuarded<T> proxies compared to hand-written guards and to no guards at all.
+// Built at -O0, -Og and -O2 (GCC/clang) with BAD_ACCESS_GUARDS_ENABLE=1, since the point is that Debug builds do not pay for the proxies.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+const size_t nbOperationsPerIteration = 10'000;
+
+#if !defined(BENCH_OPTIMIZATION_LEVEL)
+# define BENCH_OPTIMIZATION_LEVEL "default"
+#endif
+
+struct Counters
+{
+    uint64_t total = 0;
+    uint64_t nbAdds = 0;
+};
+
+class HandGuardedCounters
+{
+    Counters counters;
+    BA_GUARD_DECL(BAShadow);
+public:
+    ~HandGuardedCounters() { BA_GUARD_DESTROY(BAShadow); }
+    void Add(uint64_t amount)
+    {
+        BA_GUARD_WRITE(BAShadow);
+        counters.total += amount;
+        counters.nbAdds++;
+    }
+    uint64_t GetTotal() const
+    {
+        BA_GUARD_READ(BAShadow);
+        return counters.total;
+    }
+};
+
+int main()
+{
+    ankerl::nanobench::Bench bench;
+    bench.title("BadAccessGuarded<T> " BENCH_OPTIMIZATION_LEVEL).relative(true);
+    bench.batch(nbOperationsPerIteration).minEpochTime(minEpoch);
+
+    Counters raw;
+    bench.run("unguarded write", [&] {
+        for (size_t i = 0; i < nbOperationsPerIteration; i++)
+        {
+            raw.total += i;
+            raw.nbAdds++;
+        }
+        ankerl::nanobench::doNotOptimizeAway(raw);
+    });
+
+    HandGuardedCounters handGuarded;
+    bench.run("hand-written guard write", [&] {
+        for (size_t i = 0; i < nbOperationsPerIteration; i++) handGuarded.Add(i);
+        ankerl::nanobench::doNotOptimizeAway(handGuarded);
+    });
+
+    BadAccessGuarded<Counters> wrapped;
+    bench.run("BadAccessGuarded write", [&] {
+        for (size_t i = 0; i < nbOperationsPerIteration; i++)
+        {
+            auto counters = wrapped.Write();
+            counters->total += i;
+            counters->nbAdds++;
+        }
+        ankerl::nanobench::doNotOptimizeAway(wrapped);
+    });
+
+    uint64_t x = 0;
+    bench.run("unguarded read", [&] {
+        for (size_t i = 0; i < nbOperationsPerIteration; i++) x += raw.total;
+        ankerl::nanobench::doNotOptimizeAway(x);
+    });
+    bench.run("hand-written guard read", [&] {
+        for (size_t i = 0; i < nbOperationsPerIteration; i++) x += handGuarded.GetTotal();
+        ankerl::nanobench::doNotOptimizeAway(x);
+    });
+    bench.run("BadAccessGuarded read", [&] {
+        for (size_t i = 0; i < nbOperationsPerIteration; i++) x += wrapped.Read()->total;
+        ankerl::nanobench::doNotOptimizeAway(x);
+    });
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <BadAccessGuardPartitioned.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scaling of a parallel fill when workers write disjoint slices of the same array, guarded with a partitioned shadow.
+// - coarse: one range guard per worker slice, the usual parallel loop.
+// - per block: one range guard every `blockSize` elements, for workers that grab small batches.
+// - per element: one range guard per element, the worst case. Each worker only touches the shadows of its own chunks.
+// Threads are started for each run in all variants. Scaling obviously depends on the number of cores of the machine.
+// Built with BA_GUARD_PARTITION_CHUNK_STRIDE set to 8 (compact shadows, 8 per cache line) and 64 (one cache line per chunk), see BenchPartitioned8 and BenchPartitioned64.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#ifdef NDEBUG
+const size_t nbElements = 4'000'000;
+#else
+const size_t nbElements = 100'000;
+#endif
+const size_t blockSize = 1024;
+const size_t nbChunks = 64;
+
+struct PartitionedArray
+{
+    std::vector<uint64_t> values = std::vector<uint64_t>(nbElements);
+    BA_GUARD_PARTITIONED_DECL(BAShadow, nbChunks);
+
+    void FillUnguarded(size_t begin, size_t end, uint64_t value)
+    {
+        for (size_t i = begin; i < end; i++) values[i] = value;
+    }
+    void Fill(size_t begin, size_t end, uint64_t value)
+    {
+        BA_GUARD_WRITE_RANGE(BAShadow, begin, end, values.size());
+        for (size_t i = begin; i < end; i++) values[i] = value;
+    }
+    void FillPerBlock(size_t begin, size_t end, uint64_t value)
+    {
+        for (size_t block = begin; block < end; block += blockSize)
+        {
+            Fill(block, std::min(block + blockSize, end), value);
+        }
+    }
+    void FillPerElement(size_t begin, size_t end, uint64_t value)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            BA_GUARD_WRITE_RANGE(BAShadow, i, i + 1, values.size());
+            values[i] = value;
+        }
+    }
+};
+
+template<typename FillFunction>
+void ParallelFill(PartitionedArray& array, int nbThreads, FillFunction fill)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(nbThreads);
+    for (int thread = 0; thread < nbThreads; thread++)
+    {
+        // Slices start on chunk boundaries, so that threads never share a chunk
+        const size_t begin = BadAccessGuardChunkBegin(nbChunks * thread / nbThreads, nbChunks, nbElements);
+        const size_t end = BadAccessGuardChunkBegin(nbChunks * (thread + 1) / nbThreads, nbChunks, nbElements);
+        threads.emplace_back([&array, fill, begin, end, thread] { (array.*fill)(begin, end, uint64_t(thread)); });
+    }
+    for (std::thread& thread : threads) thread.join();
+    ankerl::nanobench::doNotOptimizeAway(array.values.data());
+}
+
+int main()
+{
+    PartitionedArray array;
+    printf("Chunk shadow stride: %d bytes, %u hardware thread(s)\n", int(BA_GUARD_PARTITION_CHUNK_STRIDE), std::thread::hardware_concurrency());
+
+    struct Variant
+    {
+        const char* name;
+        void (PartitionedArray::*fill)(size_t, size_t, uint64_t);
+    };
+    const Variant variants[] = {
+        { "unguarded", &PartitionedArray::FillUnguarded },
+        { "coarse", &PartitionedArray::Fill },
+        { "per block", &PartitionedArray::FillPerBlock },
+        { "per element", &PartitionedArray::FillPerElement },
+    };
+
+    for (const Variant& variant : variants)
+    {
+        ankerl::nanobench::Bench bench;
+        bench.title(std::string("Parallel fill - ") + variant.name).relative(true);
+        bench.batch(nbElements).minEpochTime(minEpoch);
+        for (int nbThreads = 1; nbThreads <= 8; nbThreads *= 2)
+        {
+            bench.run(std::to_string(nbThreads) + " thread(s)", [&] { ParallelFill(array, nbThreads, variant.fill); });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <BadAccessGuards.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Cost of BadAccessGuardSharedShadow compared to BadAccessGuardShadow, for objects living in a shared mapping.
+// - Single process: the only difference is the process tag, loaded from a global and merged in the stored value.
+// - Multiple processes: each one forks and increments its own table, so that we measure the guards and not contention.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+#ifdef NDEBUG
+const size_t nbIncrementsPerProcess = 1'000'000;
+#else
+const size_t nbIncrementsPerProcess = 100'000;
+#endif
+const int maxProcesses = 4;
+
+struct UnguardedTable
+{
+    alignas(64) uint64_t values[8];
+    void Increment(size_t index) { values[index % 8]++; }
+};
+
+struct GuardedTable
+{
+    alignas(64) uint64_t values[8];
+    BA_GUARD_DECL(BAShadow);
+    void Increment(size_t index) { BA_GUARD_WRITE(BAShadow); values[index % 8]++; }
+};
+
+struct SharedGuardedTable
+{
+    alignas(64) uint64_t values[8];
+    BA_GUARD_SHARED_DECL(BAShadow);
+    void Increment(size_t index) { BA_GUARD_WRITE(BAShadow); values[index % 8]++; }
+};
+
+template<typename Table>
+void IncrementLoop(Table& table, size_t nbIncrements)
+{
+    for (size_t i = 0; i < nbIncrements; i++) table.Increment(i);
+    ankerl::nanobench::doNotOptimizeAway(table.values[0]);
+}
+
+template<typename Table>
+void BenchTable(ankerl::nanobench::Bench& bench, const char* name)
+{
+    void* mapping = mmap(nullptr, sizeof(Table) * maxProcesses, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) return;
+    Table* tables = new (mapping) Table[maxProcesses]{};
+
+    bench.batch(nbIncrementsPerProcess);
+    bench.run(std::string(name) + " - 1 process", [&] { IncrementLoop(tables[0], nbIncrementsPerProcess); });
+
+    for (int nbProcesses = 2; nbProcesses <= maxProcesses; nbProcesses *= 2)
+    {
+        // Includes the cost of fork, which is why we use so many increments per process
+        bench.batch(nbIncrementsPerProcess * nbProcesses);
+        bench.run(std::string(name) + " - " + std::to_string(nbProcesses) + " processes", [&] {
+            for (int process = 0; process < nbProcesses; process++)
+            {
+                if (fork() == 0)
+                {
+                    IncrementLoop(tables[process], nbIncrementsPerProcess);
+                    _exit(0);
+                }
+            }
+            while (wait(nullptr) > 0) {}
+        });
+    }
+
+    munmap(mapping, sizeof(Table) * maxProcesses);
+}
+
+int main()
+{
+    ankerl::nanobench::Bench bench;
+    bench.title("Shared memory tables").relative(true).minEpochTime(minEpoch);
+    BenchTable<UnguardedTable>(bench, "unguarded");
+    BenchTable<GuardedTable>(bench, "BA_GUARD_DECL");
+    BenchTable<SharedGuardedTable>(bench, "BA_GUARD_SHARED_DECL");
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <BadAccessGuards.h>
+
+#include <nanobench.h>
+#include <chrono>
+
+#include <stdio.h>
+#include <string>
+
+// Cost of looking up suppression rules in the slow path. The fast path of the guards does not change.
+// We call the slow path directly, as if a guard detected a bad access, and compare with a report callback that does nothing.
+// Rules can't be removed, so each benchmark adds rules to the previous ones.
+
+using namespace std::chrono_literals;
+const auto minEpoch = 100ms;
+
+static bool IgnoreBadAccess(StateAndStackAddr, BadAccessGuardState, const BadAccessGuardSite&, const BadAccessGuardBacktrace&)
+{
+    return false;
+}
+
+int main()
+{
+#if BAD_ACCESS_GUARDS_ENABLE
+    BadAccessGuardConfig config = BadAccessGuardGetConfig();
+    config.allowBreak = false;
+    config.reportBadAccess = IgnoreBadAccess;
+    BadAccessGuardSetConfig(config);
+
+    static constexpr BadAccessGuardSite site{ "src/Legacy/LegacyTable.cpp", "LegacyTable::Insert", "LegacyTable", nullptr, 42, true };
+    static constexpr BadAccessGuardSite siteWithoutDescriptor{ nullptr, nullptr, nullptr, nullptr, 0, true };
+    const StateAndStackAddr previousOperation = BAGuard_Writing;
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Suppressions (slow path)").relative(true).minEpochTime(minEpoch);
+
+    bench.run("not suppressed, report callback does nothing", [&] { BAGuardHandleBadAccess(previousOperation, BAGuard_Writing, site); });
+
+    BadAccessGuardAddSuppressions("site:LegacyTable.cpp:42");
+    bench.run("suppressed by site, 1 rule", [&] { BAGuardHandleBadAccess(previousOperation, BAGuard_Writing, site); });
+
+    std::string manyRules;
+    for (int i = 0; i < 100; i++) manyRules += "function:Unrelated" + std::to_string(i) + ";site:Unrelated.cpp:" + std::to_string(i + 1) + ";";
+    BadAccessGuardAddSuppressions(manyRules.c_str());
+    bench.run("suppressed by site, 201 rules", [&] { BAGuardHandleBadAccess(previousOperation, BAGuard_Writing, site); });
+
+    // Any frame of the backtrace matches
+    BadAccessGuardAddSuppressions("addr:1-ffffffffffffffff");
+    bench.run("suppressed by address, 1 rule", [&] { BAGuardHandleBadAccess(previousOperation, BAGuard_Writing, siteWithoutDescriptor); });
+
+    printf("Suppressed %llu bad accesses\n", (unsigned long long)BadAccessGuardGetSuppressedCount());
+#else
+    printf("Guards are disabled, nothing to benchmark.\n");
+#endif
+    return 0;
+}
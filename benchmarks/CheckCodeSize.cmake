@@ -0,0 +1,44 @@
+# Fails if the guarded probes of CodeSizeProbes.cpp grew too much compared to their NoGuard versions.
+# Usage: cmake -DNM=<nm> -DOBJECT=<CodeSizeProbes.o> -DBUDGETS=Read=48,Write=160 -P CheckCodeSize.cmake
+# Only the hot part of the functions is measured, the compiler may move the slow path call to a `.cold` part.
+
+execute_process(
+    COMMAND ${NM} --print-size ${OBJECT}
+    OUTPUT_VARIABLE NM_OUTPUT
+    RESULT_VARIABLE NM_RESULT
+)
+if(NOT NM_RESULT EQUAL 0)
+    message(FATAL_ERROR "Failed to run ${NM} on ${OBJECT}")
+endif()
+
+string(REPLACE "\n" ";" NM_LINES "${NM_OUTPUT}")
+foreach(LINE IN LISTS NM_LINES)
+    if(LINE MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) [Tt] BAProbe_([A-Za-z_]+)$")
+        math(EXPR SIZE "0x${CMAKE_MATCH_1}")
+        set(SIZE_${CMAKE_MATCH_2} ${SIZE})
+    endif()
+endforeach()
+
+string(REPLACE "," ";" BUDGETS "${BUDGETS}")
+set(FAILED FALSE)
+foreach(BUDGET IN LISTS BUDGETS)
+    if(NOT BUDGET MATCHES "^([A-Za-z]+)=([0-9]+)$")
+        message(FATAL_ERROR "Invalid budget '${BUDGET}', expected <Probe>=<bytes>")
+    endif()
+    set(PROBE ${CMAKE_MATCH_1})
+    set(MAX_OVERHEAD ${CMAKE_MATCH_2})
+    if(NOT DEFINED SIZE_${PROBE} OR NOT DEFINED SIZE_${PROBE}_NoGuard)
+        message(FATAL_ERROR "BAProbe_${PROBE} or BAProbe_${PROBE}_NoGuard not found in ${OBJECT}")
+    endif()
+    math(EXPR OVERHEAD "${SIZE_${PROBE}} - ${SIZE_${PROBE}_NoGuard}")
+    if(OVERHEAD GREATER MAX_OVERHEAD)
+        message(SEND_ERROR "BAProbe_${PROBE}: guards add ${OVERHEAD} bytes, budget is ${MAX_OVERHEAD} bytes")
+        set(FAILED TRUE)
+    else()
+        message(STATUS "BAProbe_${PROBE}: guards add ${OVERHEAD} bytes, budget is ${MAX_OVERHEAD} bytes")
+    endif()
+endforeach()
+
+if(FAILED)
+    message(FATAL_ERROR "Code size of the guards exceeds its budget, see BadAccessGuardsCodeSize to investigate.")
+endif()
@@ -0,0 +1,24 @@
+# Checks the .note.stapsdt entries of a binary, which is what perf/bpftrace read to find the probes.
+# Usage: cmake -DREADELF=<readelf> -DBINARY=<BenchSdtProbesN> -DEXPECT_PROBES=<0|1> -P CheckSdtNotes.cmake
+
+execute_process(
+    COMMAND ${READELF} --notes ${BINARY}
+    OUTPUT_VARIABLE NOTES
+    RESULT_VARIABLE READELF_RESULT
+)
+if(NOT READELF_RESULT EQUAL 0)
+    message(FATAL_ERROR "Failed to run ${READELF} on ${BINARY}")
+endif()
+
+if(NOT EXPECT_PROBES)
+    if(NOTES MATCHES "stapsdt")
+        message(FATAL_ERROR "${BINARY} was built without probes but has stapsdt notes")
+    endif()
+    return()
+endif()
+
+foreach(PROBE guard_enter guard_exit bad_access)
+    if(NOT NOTES MATCHES "stapsdt[^\n]*\n[ \t]*Provider: bad_access_guards\n[ \t]*Name: ${PROBE}\n")
+        message(FATAL_ERROR "No stapsdt note for bad_access_guards:${PROBE} in ${BINARY}")
+    endif()
+endforeach()
@@ -0,0 +1,81 @@
+#include <BadAccessGuards.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small functions containing the guards, to check the code they generate without the noise of a full benchmark.
+// Build the `BadAccessGuardsCodeSize` target to print their sizes and disassembly.
+// What to look for: the fast path should only be a load, a test and a branch to the slow path call at the end of the function,
+// and loops containing guards should not spill/reload registers around that call. Compare with the `NoGuard` versions.
+
+struct ProbeObject
+{
+    uint64_t* values;
+    size_t count;
+    BA_GUARD_DECL(shadow);
+};
+
+extern "C" {
+
+uint64_t BAProbe_Read_NoGuard(const ProbeObject& obj, size_t index)
+{
+    return obj.values[index];
+}
+
+uint64_t BAProbe_Read(const ProbeObject& obj, size_t index)
+{
+    BA_GUARD_READ(obj.shadow);
+    return obj.values[index];
+}
+
+void BAProbe_Write_NoGuard(ProbeObject& obj, size_t index, uint64_t value)
+{
+    obj.values[index] = value;
+}
+
+void BAProbe_Write(ProbeObject& obj, size_t index, uint64_t value)
+{
+    BA_GUARD_WRITE(obj.shadow);
+    obj.values[index] = value;
+}
+
+// Many live values across the guards, this is where clobbered registers hurt.
+uint64_t BAProbe_ReadLoop_NoGuard(const ProbeObject& obj, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < obj.count; i++)
+    {
+        sum += (obj.values[i] * a + b) ^ (c - d * i);
+    }
+    return sum;
+}
+
+uint64_t BAProbe_ReadLoop(const ProbeObject& obj, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < obj.count; i++)
+    {
+        BA_GUARD_READ(obj.shadow);
+        sum += (obj.values[i] * a + b) ^ (c - d * i);
+    }
+    return sum;
+}
+
+void BAProbe_WriteLoop_NoGuard(ProbeObject& obj, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+    for (size_t i = 0; i < obj.count; i++)
+    {
+        obj.values[i] = (obj.values[i] * a + b) ^ (c - d * i);
+    }
+}
+
+void BAProbe_WriteLoop(ProbeObject& obj, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+    for (size_t i = 0; i < obj.count; i++)
+    {
+        BA_GUARD_WRITE(obj.shadow);
+        obj.values[i] = (obj.values[i] * a + b) ^ (c - d * i);
+    }
+}
+
+}
@@ -0,0 +1,58 @@
+﻿#include <stdio.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <BadAccessGuards.h>
+
+#if !BAD_ACCESS_GUARDS_ENABLE || !BAD_ACCESS_GUARDS_CENSUS
+# error "This example needs BAD_ACCESS_GUARDS_ENABLE=1 and BAD_ACCESS_GUARDS_CENSUS=N"
+#endif
+
+struct GuardedCounter
+{
+    uint64_t value = 0;
+    BA_GUARD_DECL(BAShadow);
+
+    void Add(uint64_t amount)
+    {
+        BA_GUARD_WRITE(BAShadow);
+        value += amount;
+    }
+};
+
+int main()
+{
+    GuardedCounter perThread[2];    // Each thread only writes its own
+    GuardedCounter sharedOften;     // Written by both threads all the time, under a lock
+    GuardedCounter sharedSometimes; // Written by both threads once in a while, under a lock
+    std::mutex mutex;
+    std::condition_variable turnChanged;
+    int turn = 0;
+
+    // Threads take turns so that objects are actually handed off, even on a single core
+    auto work = [&](int threadIndex) {
+        for (int i = 0; i < 1'000; i++)
+        {
+            perThread[threadIndex].Add(1);
+            std::unique_lock<std::mutex> lock(mutex);
+            turnChanged.wait(lock, [&] { return turn == threadIndex; });
+            sharedOften.Add(1);
+            if (i % 10 == 0) sharedSometimes.Add(1);
+            turn = 1 - threadIndex;
+            turnChanged.notify_one();
+        }
+    };
+    std::thread other(work, 1);
+    work(0);
+    other.join();
+
+    printf("perThread[0]:    shadow=%p\n", (void*)&perThread[0].BAShadow);
+    printf("perThread[1]:    shadow=%p\n", (void*)&perThread[1].BAShadow);
+    printf("sharedOften:     shadow=%p\n", (void*)&sharedOften.BAShadow);
+    printf("sharedSometimes: shadow=%p\n", (void*)&sharedSometimes.BAShadow);
+    printf("Only the shared counters should be listed, the most handed off first. Output:\n");
+    fflush(stdout); // Reports go to stderr
+    BadAccessGuardDumpCensus(10);
+    return 0;
+}
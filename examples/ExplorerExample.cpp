@@ -0,0 +1,77 @@
+﻿#include <stdio.h>
+#include <memory>
+#include <BadAccessGuardsExplorer.h>
+#include "GuardedVectorExample.h"
+
+#if !BAD_ACCESS_GUARDS_ENABLE || !BAD_ACCESS_GUARDS_SCHEDULING_POINTS
+# error "This example needs BAD_ACCESS_GUARDS_ENABLE=1 and BAD_ACCESS_GUARDS_SCHEDULING_POINTS=1"
+#endif
+
+// A scenario that is racy, but where the race window is so small that running it with real threads would almost never detect it.
+static BadAccessGuardExplorerThreads MakeScenario()
+{
+    auto vec = std::make_shared<ExampleGuardedVector<int>>();
+    return {
+        [vec] { vec->push_back(1); },
+        [vec] { volatile size_t size = vec->size(); (void)size; },
+    };
+}
+
+// Returns non-zero if the race is not found, or if replaying it does not reproduce it, so that it can run as a test.
+int main()
+{
+    int nbFailures = 0;
+    {
+        printf("Exploring interleavings at random:\n");
+        BadAccessGuardExplorerOptions options;
+        options.seed = 42;
+        const BadAccessGuardExplorerResult result = BadAccessGuardExplore(MakeScenario, options);
+        if (result.detections == 0)
+        {
+            printf("No race found in %d iteration(s)!\n", result.iterations);
+            nbFailures++;
+        }
+        else
+        {
+            printf("Found a race after %d iteration(s), seed %llu.\n", result.iterations, (unsigned long long)result.failingSeed);
+
+            // Running again from the failing seed gives the exact same interleaving
+            options.seed = result.failingSeed;
+            options.maxIterations = 1;
+            options.reportDetections = true;
+            printf("\nReplaying seed %llu, output:\n", (unsigned long long)options.seed);
+            fflush(stdout); // Reports go to stderr
+            const BadAccessGuardExplorerResult replayed = BadAccessGuardExplore(MakeScenario, options);
+            if (replayed.detections != 1 || replayed.failingSeed != result.failingSeed)
+            {
+                printf("Replaying seed %llu did not reproduce the race!\n", (unsigned long long)result.failingSeed);
+                nbFailures++;
+            }
+        }
+    }
+
+    {
+        printf("\n\nExploring all interleavings systematically:\n");
+        BadAccessGuardExplorerOptions options;
+        options.systematic = true;
+        options.stopOnFirstDetection = false;
+        const BadAccessGuardExplorerResult result = BadAccessGuardExplore(MakeScenario, options);
+        printf("%d of the %d interleavings%s were detected as racy.\n", result.detections, result.iterations, result.exhausted ? "" : " (not exhaustive)");
+        if (result.detections == 0 || !result.exhausted)
+        {
+            printf("Expected an exhaustive exploration finding at least one race!\n");
+            nbFailures++;
+        }
+        else
+        {
+            printf("\nReplaying the first failing schedule, output:\n");
+            fflush(stdout);
+            if (!BadAccessGuardExplorerReplay(MakeScenario, result.failingSchedule))
+            {
+                printf("Replaying the schedule did not reproduce the race!\n");
+                nbFailures++;
+            }
+        }
+    }
+    return nbFailures;
+}
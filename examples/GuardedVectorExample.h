@@ -19,6 +19,12 @@ public:
         BA_GUARD_DESTROY(BAShadow);
     }
 
+    // Once filled, may only be read
+    void freeze()
+    {
+        BA_GUARD_FREEZE(BAShadow);
+    }
+
     ExampleGuardedVector& operator=(ExampleGuardedVector&& rhs)
     {
         BA_GUARD_WRITE(BAShadow);
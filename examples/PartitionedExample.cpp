@@ -0,0 +1,88 @@
+﻿#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include <BadAccessGuardPartitioned.h>
+
+#if !BAD_ACCESS_GUARDS_ENABLE
+# error "Can't really test the guards if we don't enable them can we ?"
+#endif
+
+// An array that workers fill in parallel, each one its own slice.
+struct ParallelArray
+{
+    static constexpr size_t NbChunks = 64;
+    std::vector<uint64_t> values;
+    BA_GUARD_PARTITIONED_DECL(BAShadow, NbChunks);
+
+    void Fill(size_t begin, size_t end, uint64_t value)
+    {
+        BA_GUARD_WRITE_RANGE(BAShadow, begin, end, values.size());
+        for (size_t i = begin; i < end; i++) values[i] = value;
+    }
+    void Resize(size_t newSize)
+    {
+        BA_GUARD_WRITE(BAShadow); // Takes all the chunks
+        values.resize(newSize);
+    }
+    ~ParallelArray()
+    {
+        BA_GUARD_DESTROY(BAShadow);
+    }
+};
+
+static BadAccessGuardConfig::ReportBadAccessFunction* gDefaultReportBadAccess = nullptr;
+static int gNbDetections = 0;
+
+static bool CountBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace)
+{
+    gNbDetections++;
+    return gDefaultReportBadAccess(previousOperation, toState, site, backtrace);
+}
+
+int main()
+{
+    BadAccessGuardConfig config = BadAccessGuardGetConfig();
+    gDefaultReportBadAccess = config.reportBadAccess;
+    config.allowBreak = false;
+    config.reportBadAccess = CountBadAccess;
+    BadAccessGuardSetConfig(config);
+
+    ParallelArray array;
+    array.Resize(1000);
+    const size_t size = array.values.size();
+
+    {
+        const int nbWorkers = 4;
+        std::vector<std::thread> workers;
+        for (int worker = 0; worker < nbWorkers; worker++)
+        {
+            // Slices start on chunk boundaries, so that workers never share a chunk
+            const size_t begin = BadAccessGuardChunkBegin(ParallelArray::NbChunks * worker / nbWorkers, ParallelArray::NbChunks, size);
+            const size_t end = BadAccessGuardChunkBegin(ParallelArray::NbChunks * (worker + 1) / nbWorkers, ParallelArray::NbChunks, size);
+            workers.emplace_back([&array, begin, end, worker] { array.Fill(begin, end, uint64_t(worker)); });
+        }
+        for (std::thread& worker : workers) worker.join();
+        printf("Parallel fill of disjoint slices: %d bad access(es) detected\n", gNbDetections);
+    }
+
+    const size_t half = BadAccessGuardChunkBegin(ParallelArray::NbChunks / 2, ParallelArray::NbChunks, size);
+    {
+        BA_GUARD_WRITE_RANGE(array.BAShadow, 0, half, size); // As if this thread was still writing the first half
+        std::thread([&] { array.Fill(half, size, 1); }).join();
+        printf("Writing the second half while the first one is being written: %d bad access(es) detected\n", gNbDetections);
+        fflush(stdout); // Reports go to stderr
+
+        printf("\nTesting overlapping slices, output:\n");
+        fflush(stdout);
+        std::thread([&] { array.Fill(half - 10, size, 2); }).join();
+    }
+    {
+        printf("\nTesting a resize while a slice is being written, output:\n");
+        fflush(stdout);
+        BA_GUARD_WRITE_RANGE(array.BAShadow, half, size, size);
+        std::thread([&] { array.Resize(2000); }).join();
+    }
+    printf("\n%d bad access(es) detected in total\n", gNbDetections);
+    return 0;
+}
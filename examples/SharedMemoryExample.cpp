@@ -0,0 +1,165 @@
+﻿#include <stdio.h>
+#include <stdint.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <BadAccessGuards.h>
+
+#if !BAD_ACCESS_GUARDS_ENABLE
+# error "Can't really test the guards if we don't enable them can we ?"
+#endif
+
+// A table living in memory shared between processes, as you would get with shm_open + mmap.
+// Its shadow also lives in the shared memory, and records which process is using it.
+struct SharedTable
+{
+    uint64_t values[64];
+    BA_GUARD_SHARED_DECL(BAShadow);
+
+    void Increment(size_t index)
+    {
+        BA_GUARD_WRITE(BAShadow);
+        values[index % 64]++;
+    }
+    uint64_t Get(size_t index) const
+    {
+        BA_GUARD_READ(BAShadow);
+        return values[index % 64];
+    }
+};
+
+struct SharedMemory
+{
+    SharedTable table;
+    int nbReady; // Start barrier, so that both processes actually run at the same time
+    int handoffStep; // Orders the processes in the handoff test
+};
+
+static BadAccessGuardConfig::ReportBadAccessFunction* gDefaultReportBadAccess = nullptr;
+static int gNbDetections = 0;
+static int gNbOtherProcessDetections = 0;
+
+static uint32_t OwnProcessTag() { return BadAccessGuardSharedShadow::GetProcessTag(gBadAccessGuardProcessTag); }
+
+// Only print the first detection of each process, races happen thousands of times in this example.
+static bool ReportFirstBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace)
+{
+    const uint32_t previousTag = BadAccessGuardSharedShadow::GetProcessTag(previousOperation);
+    if (previousTag != 0 && previousTag != OwnProcessTag()) gNbOtherProcessDetections++;
+    if (gNbDetections++ == 0)
+    {
+        return gDefaultReportBadAccess(previousOperation, toState, site, backtrace);
+    }
+    return false;
+}
+
+static void WaitForStep(SharedMemory& memory, int step)
+{
+    while (__atomic_load_n(&memory.handoffStep, __ATOMIC_ACQUIRE) < step) {}
+}
+
+static void SetStep(SharedMemory& memory, int step)
+{
+    __atomic_store_n(&memory.handoffStep, step, __ATOMIC_RELEASE);
+}
+
+// Deterministic: the child reads the table while the parent is known to be inside a write guard.
+// Returns the exit code of the child, 0 if it detected the write of the other process.
+static int TestHandoff(SharedMemory& memory)
+{
+    const pid_t child = fork();
+    if (child < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0)
+    {
+        gNbDetections = 0;
+        gNbOtherProcessDetections = 0;
+        WaitForStep(memory, 1);
+        memory.table.Get(0);
+        SetStep(memory, 2);
+        // May fail if both processes have the same tag (1 chance in 65535), see BadAccessGuardSharedShadow.
+        _exit(gNbOtherProcessDetections == 1 ? 0 : 1);
+    }
+    {
+        BA_GUARD_WRITE(memory.table.BAShadow);
+        SetStep(memory, 1);
+        WaitForStep(memory, 2); // Leave the guard only once the child has read
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static void Hammer(SharedMemory& memory, const char* processName)
+{
+    __atomic_add_fetch(&memory.nbReady, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&memory.nbReady, __ATOMIC_ACQUIRE) < 2) {}
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < 1'000'000; i++)
+    {
+        memory.table.Increment(i);
+        sum += memory.table.Get(i + 1);
+    }
+    printf("%s (pid %d, process tag %u): %d bad access(es) detected, checksum %llu\n", processName, int(getpid()), OwnProcessTag(), gNbDetections, (unsigned long long)sum);
+    fflush(stdout);
+}
+
+int main()
+{
+    BadAccessGuardConfig config = BadAccessGuardGetConfig();
+    gDefaultReportBadAccess = config.reportBadAccess;
+    config.allowBreak = false;
+    config.reportBadAccess = ReportFirstBadAccess;
+    BadAccessGuardSetConfig(config);
+
+    void* mapping = mmap(nullptr, sizeof(SharedMemory), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    SharedMemory& memory = *new (mapping) SharedMemory{};
+
+    // A recursion within a single process is still reported as such with a shared shadow
+    {
+        printf("Testing read during write on the same thread, output:\n");
+        fflush(stdout); // Reports go to stderr
+        BA_GUARD_WRITE(memory.table.BAShadow);
+        memory.table.Get(0);
+        gNbDetections = 0;
+    }
+
+    printf("\nTesting a read in a child process while the parent (process tag %u) writes, output:\n", OwnProcessTag());
+    fflush(stdout);
+    const int handoffResult = TestHandoff(memory);
+    if (handoffResult != 0)
+    {
+        fprintf(stderr, "The read of the child process was not reported as a race with another process!\n");
+    }
+
+    // Not checked: whether the processes actually overlap depends on the scheduler.
+    printf("\nTesting two processes writing to the same shared table, output:\n");
+    fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0)
+    {
+        Hammer(memory, "Child");
+        _exit(0);
+    }
+    Hammer(memory, "Parent");
+    waitpid(child, nullptr, 0);
+
+    memory.~SharedMemory();
+    munmap(mapping, sizeof(SharedMemory));
+    return handoffResult;
+}
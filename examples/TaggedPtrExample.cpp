@@ -0,0 +1,77 @@
+﻿#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+#include <BadAccessGuardTaggedPtr.h>
+
+#if !BAD_ACCESS_GUARDS_ENABLE
+# error "Can't really test the guards if we don't enable them can we ?"
+#endif
+
+// A small view over an array, of which there are many: the shadow lives in the data pointer instead of taking another word.
+struct GuardedSpan
+{
+    BA_GUARD_TAGGED_PTR_DECL(uint32_t, data);
+    uint32_t size = 0;
+    uint32_t generation = 0;
+
+    uint32_t Get(uint32_t index) const
+    {
+        BA_GUARD_READ(data);
+        return data.Get()[index];
+    }
+    template<typename Func>
+    void Reset(uint32_t* newData, uint32_t newSize, Func&& whileResetting)
+    {
+        BA_GUARD_WRITE(data);
+        whileResetting();
+        data.Set(newData);
+        size = newSize;
+        generation++;
+    }
+};
+
+struct GuardedSpanWithShadow
+{
+    uint32_t* data = nullptr;
+    uint32_t size = 0;
+    uint32_t generation = 0;
+    BA_GUARD_DECL(BAShadow);
+};
+
+static BadAccessGuardConfig::ReportBadAccessFunction* gDefaultReportBadAccess = nullptr;
+static int gNbDetections = 0;
+
+static bool CountBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace)
+{
+    gNbDetections++;
+    return gDefaultReportBadAccess(previousOperation, toState, site, backtrace);
+}
+
+int main()
+{
+    BadAccessGuardConfig config = BadAccessGuardGetConfig();
+    gDefaultReportBadAccess = config.reportBadAccess;
+    config.allowBreak = false;
+    config.reportBadAccess = CountBadAccess;
+    BadAccessGuardSetConfig(config);
+
+    printf("sizeof(GuardedSpan) = %zu, sizeof(GuardedSpanWithShadow) = %zu\n", sizeof(GuardedSpan), sizeof(GuardedSpanWithShadow));
+
+    uint32_t values[4] = { 1, 2, 3, 4 };
+    uint32_t otherValues[2] = { 5, 6 };
+    GuardedSpan span;
+    span.Reset(values, 4, [] {});
+    printf("span.Get(2) = %u, %d bad access(es) detected\n", span.Get(2), gNbDetections);
+
+    printf("\nTesting a read while resetting the span, output:\n");
+    fflush(stdout); // Reports go to stderr
+    span.Reset(otherValues, 2, [&] { span.Get(0); });
+
+    printf("\nTesting a read from another thread while resetting the span, output:\n");
+    fflush(stdout);
+    span.Reset(values, 4, [&] { std::thread([&] { span.Get(0); }).join(); });
+
+    printf("\nThe pointer is intact: span.Get(3) = %u\n", span.Get(3));
+    printf("%d bad access(es) detected in total\n", gNbDetections);
+    return 0;
+}
@@ -0,0 +1,238 @@
+﻿// BadAccessGuards v1.0.0 https://github.com/Lectem/BadAccessGuards
+#pragma once
+
+// Guards for containers whose disjoint ranges may be written concurrently, typically parallel loops where each worker fills its own slice of an array.
+// A single shadow would report those legal writes, so the container is split in `NbChunks` chunks, each with its own shadow in a compact side array:
+//
+//     struct ParticleArray
+//     {
+//         float* positions;
+//         size_t size;
+//         BA_GUARD_PARTITIONED_DECL(BAShadow, 64);
+//
+//         void Update(size_t begin, size_t end) { BA_GUARD_WRITE_RANGE(BAShadow, begin, end, size); ... } // Only the chunks of [begin, end)
+//         void Resize(size_t newSize) { BA_GUARD_WRITE(BAShadow); ... }                                     // All the chunks
+//         ~ParticleArray() { BA_GUARD_DESTROY(BAShadow); }
+//     };
+//
+// Element `i` belongs to chunk `i * NbChunks / size`, so chunks follow the size of the container. Changing the size must take all the chunks.
+// Two ranges touching the same chunk are reported as a bad access even if they do not overlap: split the work on `BadAccessGuardChunkBegin` boundaries.
+// `BA_GUARD_READ`, `BA_GUARD_WRITE`, `BA_GUARD_DESTROY` and `BA_GUARD_FREEZE` take all the chunks. The `_EX` and `_SITE` versions are not supported.
+// Each chunk shadow takes `BA_GUARD_PARTITION_CHUNK_STRIDE` bytes (a cache line by default), so that threads writing neighbouring chunks do not invalidate each other's cache line.
+// Set it to `sizeof(BadAccessGuardShadow)` for a compact side array, when memory matters more than parallel writes.
+// With `BAD_ACCESS_GUARDS_WRITE_STACK`, a range write takes a single entry of the write stack, for its first chunk: a leaked range write is reported for that chunk only.
+
+#include "BadAccessGuards.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// First element of `chunk` for a container of `size` elements split in `nbChunks` chunks. Available even when the guards are disabled.
+inline size_t BadAccessGuardChunkBegin(size_t chunk, size_t nbChunks, size_t size)
+{
+    return size_t((uint64_t(chunk) * size + nbChunks - 1) / nbChunks);
+}
+
+#if BAD_ACCESS_GUARDS_ENABLE
+
+#if !defined(BA_GUARD_PARTITION_CHUNK_STRIDE)
+# define BA_GUARD_PARTITION_CHUNK_STRIDE 64 // Bytes taken by each chunk shadow, should be the cache line size
+#endif
+
+// Padded rather than aligned: two shadows BA_GUARD_PARTITION_CHUNK_STRIDE bytes apart never share a line, and this does not need C++17 aligned allocations.
+template<size_t Padding = BA_GUARD_PARTITION_CHUNK_STRIDE - sizeof(BadAccessGuardShadow)>
+struct BadAccessGuardChunkShadowT : BadAccessGuardShadow
+{
+    char padding[Padding];
+};
+template<>
+struct BadAccessGuardChunkShadowT<0> : BadAccessGuardShadow {};
+using BadAccessGuardChunkShadow = BadAccessGuardChunkShadowT<>;
+static_assert(sizeof(BadAccessGuardChunkShadow) == BA_GUARD_PARTITION_CHUNK_STRIDE, "BA_GUARD_PARTITION_CHUNK_STRIDE must be a multiple of the size of a shadow");
+
+template<size_t NbChunks>
+struct BadAccessGuardPartitionedShadow
+{
+    static_assert(NbChunks > 0, "Need at least one chunk");
+    BadAccessGuardChunkShadow chunks[NbChunks];
+
+    // Assumes `index * NbChunks` does not overflow 64 bits
+    static BA_GUARD_FORCE_INLINE size_t GetChunk(size_t index, size_t size) { return size_t(uint64_t(index) * NbChunks / size); }
+};
+
+// Same steps as BadAccessGuardReadT/BadAccessGuardWriteT, for a single chunk.
+// `reported` avoids reporting the same operation once per chunk, a whole container write would otherwise flood the logs.
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardChunkRead(BadAccessGuardShadow& chunk, bool& reported)
+{
+    BA_GUARD_RECORD(chunk, BAGuardOp_Read);
+    const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(chunk.stateAndInStackAddr);
+    BA_GUARD_PROBE(guard_enter, chunk, BAGuard_ReadingOrIdle, lastSeenOp);
+    if (BadAccessGuardShadow::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY
+    {
+        BA_GUARD_PROBE(bad_access, chunk, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (!reported) BAGuardHandleBadAccess(lastSeenOp, BAGuard_ReadingOrIdle);
+        reported = true;
+    }
+}
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardChunkWriteBegin(BadAccessGuardShadow& chunk, bool& reported)
+{
+    BA_GUARD_RECORD(chunk, BAGuardOp_WriteBegin);
+    const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(chunk.stateAndInStackAddr);
+    BA_GUARD_PROBE(guard_enter, chunk, BAGuard_Writing, lastSeenOp);
+    if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
+    {
+        BA_GUARD_PROBE(bad_access, chunk, BAGuard_Writing, lastSeenOp);
+        if (!reported) BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing);
+        reported = true;
+        if (BadAccessGuardShadow::GetState(lastSeenOp) == BAGuard_Frozen) return; // Stays frozen
+    }
+    BA_GUARD_CENSUS(chunk, BadAccessGuardShadow::GetInStackAddr(lastSeenOp));
+    chunk.SetStateAtomicRelaxed(BAGuard_Writing);
+}
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardChunkWriteEnd(BadAccessGuardShadow& chunk, bool& reported)
+{
+    BA_GUARD_RECORD(chunk, BAGuardOp_WriteEnd);
+    const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(chunk.stateAndInStackAddr);
+    BA_GUARD_PROBE(guard_exit, chunk, BAGuard_ReadingOrIdle, lastSeenOp);
+    if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_Writing) BA_GUARD_UNLIKELY
+    {
+        if (BadAccessGuardShadow::GetState(lastSeenOp) == BAGuard_Frozen) return; // Already reported
+        BA_GUARD_PROBE(bad_access, chunk, BAGuard_Writing, lastSeenOp);
+        if (!reported) BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing);
+        reported = true;
+    }
+    chunk.SetStateAtomicRelaxed(BAGuard_ReadingOrIdle);
+}
+
+// Chunks touched by a range, as pointers into the side array. Empty ranges touch no chunk.
+struct BadAccessGuardChunkRange
+{
+    BadAccessGuardChunkShadow* first;
+    BadAccessGuardChunkShadow* last; // One past the last chunk
+
+    template<size_t NbChunks>
+    static BA_GUARD_FORCE_INLINE BadAccessGuardChunkRange Get(BadAccessGuardPartitionedShadow<NbChunks>& shadow, size_t begin, size_t end, size_t size)
+    {
+        if (begin >= end || begin >= size) return { shadow.chunks, shadow.chunks };
+        const size_t lastChunk = end >= size ? NbChunks - 1 : shadow.GetChunk(end - 1, size);
+        return { shadow.chunks + shadow.GetChunk(begin, size), shadow.chunks + lastChunk + 1 };
+    }
+    template<size_t NbChunks>
+    static BA_GUARD_FORCE_INLINE BadAccessGuardChunkRange All(BadAccessGuardPartitionedShadow<NbChunks>& shadow)
+    {
+        return { shadow.chunks, shadow.chunks + NbChunks };
+    }
+};
+
+struct BadAccessGuardReadRange
+{
+    template<size_t NbChunks>
+    BA_GUARD_FORCE_INLINE BadAccessGuardReadRange(BadAccessGuardPartitionedShadow<NbChunks>& shadow, size_t begin, size_t end, size_t size)
+    {
+        Check(BadAccessGuardChunkRange::Get(shadow, begin, end, size));
+    }
+    template<size_t NbChunks>
+    BA_GUARD_FORCE_INLINE BadAccessGuardReadRange(BadAccessGuardPartitionedShadow<NbChunks>& shadow)
+    {
+        Check(BadAccessGuardChunkRange::All(shadow));
+    }
+private:
+    static BA_GUARD_FORCE_INLINE void Check(BadAccessGuardChunkRange range)
+    {
+        if (range.first == range.last) return;
+        BA_GUARD_SCHEDULING_POINT(*range.first);
+        bool reported = false;
+        for (BadAccessGuardChunkShadow* chunk = range.first; chunk != range.last; chunk++) BadAccessGuardChunkRead(*chunk, reported);
+    }
+};
+
+struct BadAccessGuardWriteRange
+{
+    const BadAccessGuardChunkRange range;
+
+    template<size_t NbChunks>
+    BA_GUARD_FORCE_INLINE BadAccessGuardWriteRange(BadAccessGuardPartitionedShadow<NbChunks>& shadow, size_t begin, size_t end, size_t size)
+        : range(BadAccessGuardChunkRange::Get(shadow, begin, end, size))
+    {
+        Begin();
+    }
+    template<size_t NbChunks>
+    BA_GUARD_FORCE_INLINE BadAccessGuardWriteRange(BadAccessGuardPartitionedShadow<NbChunks>& shadow)
+        : range(BadAccessGuardChunkRange::All(shadow))
+    {
+        Begin();
+    }
+    BA_GUARD_FORCE_INLINE ~BadAccessGuardWriteRange()
+    {
+        if (range.first == range.last) return;
+        BA_GUARD_AMPLIFY(*range.first);
+        BA_GUARD_STACK_POP(*range.first);
+        BA_GUARD_SCHEDULING_POINT(*range.first);
+        bool reported = false;
+        for (BadAccessGuardChunkShadow* chunk = range.first; chunk != range.last; chunk++) BadAccessGuardChunkWriteEnd(*chunk, reported);
+    }
+private:
+    BA_GUARD_FORCE_INLINE void Begin()
+    {
+        if (range.first == range.last) return;
+        BA_GUARD_STACK_PUSH(*range.first);
+        bool reported = false;
+        for (BadAccessGuardChunkShadow* chunk = range.first; chunk != range.last; chunk++) BadAccessGuardChunkWriteBegin(*chunk, reported);
+        BA_GUARD_SCHEDULING_POINT(*range.first); // Let other threads run while we are writing
+    }
+};
+
+// Whole container operations, so that the regular macros work on partitioned shadows.
+template<size_t NbChunks>
+struct BadAccessGuardReadT<BadAccessGuardPartitionedShadow<NbChunks>> : BadAccessGuardReadRange
+{
+    using BadAccessGuardReadRange::BadAccessGuardReadRange;
+};
+
+template<size_t NbChunks>
+struct BadAccessGuardWriteT<BadAccessGuardPartitionedShadow<NbChunks>> : BadAccessGuardWriteRange
+{
+    using BadAccessGuardWriteRange::BadAccessGuardWriteRange;
+};
+
+template<size_t NbChunks>
+struct BadAccessGuardDestroyT<BadAccessGuardPartitionedShadow<NbChunks>>
+{
+    BA_GUARD_FORCE_INLINE BadAccessGuardDestroyT(BadAccessGuardPartitionedShadow<NbChunks>& shadow)
+    {
+        BA_GUARD_SCHEDULING_POINT(shadow.chunks[0]);
+        bool reported = false;
+        for (BadAccessGuardShadow& chunk : shadow.chunks)
+        {
+            BA_GUARD_RECORD(chunk, BAGuardOp_Destroy);
+            const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(chunk.stateAndInStackAddr);
+            BA_GUARD_PROBE(guard_enter, chunk, BAGuard_DestructorCalled, lastSeenOp);
+            if (BadAccessGuardShadow::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY
+            {
+                BA_GUARD_PROBE(bad_access, chunk, BAGuard_Writing, lastSeenOp);
+                if (!reported) BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing);
+                reported = true;
+            }
+            chunk.SetStateAtomicRelaxed(BAGuard_DestructorCalled);
+        }
+    }
+};
+
+// Freezes all the chunks.
+template<size_t NbChunks>
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardFreeze(BadAccessGuardPartitionedShadow<NbChunks>& shadow)
+{
+    for (BadAccessGuardShadow& chunk : shadow.chunks) BadAccessGuardFreeze(chunk);
+}
+
+#define BA_GUARD_PARTITIONED_DECL(SHADOWNAME,NBCHUNKS)          mutable BadAccessGuardPartitionedShadow<NBCHUNKS> SHADOWNAME
+// Guards the elements [BEGIN, END) of a container of SIZE elements.
+#define BA_GUARD_READ_RANGE(SHADOWNAME,BEGIN,END,SIZE)          BadAccessGuardReadRange BA_GUARD_MERGE_NAME(BAGuardReadRange_,__COUNTER__){SHADOWNAME, size_t(BEGIN), size_t(END), size_t(SIZE)}
+#define BA_GUARD_WRITE_RANGE(SHADOWNAME,BEGIN,END,SIZE)         BadAccessGuardWriteRange BA_GUARD_MERGE_NAME(BAGuardWriteRange_,__COUNTER__){SHADOWNAME, size_t(BEGIN), size_t(END), size_t(SIZE)}
+
+#else // BAD_ACCESS_GUARDS_ENABLE
+
+#define BA_GUARD_PARTITIONED_DECL(SHADOWNAME,NBCHUNKS)
+#define BA_GUARD_READ_RANGE(SHADOWNAME,BEGIN,END,SIZE)          do {} while(false)
+#define BA_GUARD_WRITE_RANGE(SHADOWNAME,BEGIN,END,SIZE)         do {} while(false)
+
+#endif // BAD_ACCESS_GUARDS_ENABLE
@@ -0,0 +1,149 @@
+﻿// BadAccessGuards v1.0.0 https://github.com/Lectem/BadAccessGuards
+#pragma once
+
+// A pointer which is also the shadow of its owner, for small objects (handles, spans...) where an extra word per object is too much:
+//
+//     struct Span
+//     {
+//         BA_GUARD_TAGGED_PTR_DECL(float, data); // Instead of `float* data;` and `BA_GUARD_DECL(BAShadow);`
+//         size_t size;
+//
+//         float& operator[](size_t i) { BA_GUARD_READ(data); return data.Get()[i]; }
+//         void Reset(float* newData, size_t newSize) { BA_GUARD_WRITE(data); data.Set(newData); size = newSize; }
+//     };
+//
+// On 64 bits platforms, the state lives in the 2 lower bits of the pointer, and the tag of the last thread to write in its 16 upper bits.
+// - `T` must be aligned on at least 4 bytes, and addresses must fit in 48 bits (no 5-level paging nor top byte tagging, which would use the same bits).
+//   The constructor and `Set()` report other pointers as an assertion, and drop the bits they can't store.
+// - Always use `Get()` and `Set()`, which strip and keep the tag. Only call `Set()` inside a write guard: other guards store the pointer along with their state.
+// - Threads are identified by a tag instead of a stack address. Reports still tell recursions and races apart, but cannot name the other thread.
+//   Write guards read it from a thread local, and setting the state is a load and a store instead of a single store.
+// - Skipped by the sharing census, which needs a stack address. Not supported by `BadAccessGuardAuditShadows` on Windows (where regular shadows use 8 bits for the state).
+// On 32 bits platforms, there are no unused bits: it holds the pointer next to a regular shadow. When guards are disabled, it is a plain pointer.
+
+#include "BadAccessGuards.h"
+#include <stdint.h>
+
+#if BAD_ACCESS_GUARDS_ENABLE && UINTPTR_MAX > 0xFFFFFFFF
+
+// Tag of the current thread, already shifted. 0 until its first write to a tagged pointer.
+inline BA_GUARD_FORCE_INLINE StateAndStackAddr& BadAccessGuardThreadTag()
+{
+    static BA_GUARD_THREAD_LOCAL StateAndStackAddr tag = 0;
+    return tag;
+}
+
+inline BA_GUARD_NO_INLINE StateAndStackAddr BadAccessGuardAcquireThreadTag()
+{
+    static uint32_t nbThreads = 0;
+#if defined(_MSC_VER)
+    const uint32_t threadIndex = uint32_t(_InterlockedIncrement(reinterpret_cast<volatile long*>(&nbThreads)));
+#else
+    const uint32_t threadIndex = __atomic_add_fetch(&nbThreads, 1, __ATOMIC_RELAXED);
+#endif
+    // Never 0 so that we only get here once per thread. Tags are reused after 65535 threads, reports may then see a race as a recursion.
+    BadAccessGuardThreadTag() = StateAndStackAddr(threadIndex % 0xFFFF + 1) << 48;
+    return BadAccessGuardThreadTag();
+}
+
+struct BadAccessGuardTaggedPtrBase : BadAccessGuardShadow
+{
+    static constexpr StateAndStackAddr StateMask = 3;
+    static constexpr int ThreadTagShift = 48;
+    static constexpr StateAndStackAddr ThreadTagMask = StateAndStackAddr(0xFFFF) << ThreadTagShift;
+    static constexpr StateAndStackAddr PointerMask = ~(ThreadTagMask | StateMask);
+    static constexpr StateAndStackAddr WritingOrDestroyedMask = StateMask & ~StateAndStackAddr(BAGuard_Frozen);
+    static constexpr bool HasInStackAddr = false;
+    static_assert(BAGuard_StatesCount <= StateMask + 1, "BadAccessGuardState must fit in the lower bits");
+
+    // Hide the ones of BadAccessGuardShadow, which uses 8 bits for the state on Windows
+    static BA_GUARD_FORCE_INLINE BadAccessGuardState GetState(StateAndStackAddr packedValue) { return BadAccessGuardState(packedValue & StateMask); }
+    static BA_GUARD_FORCE_INLINE bool IsWritingOrDestroyed(StateAndStackAddr packedValue) { return (packedValue & WritingOrDestroyedMask) != 0; }
+    static BA_GUARD_FORCE_INLINE void* GetInStackAddr(StateAndStackAddr) { return nullptr; } // Unknown
+    static BA_GUARD_FORCE_INLINE uint32_t GetThreadTag(StateAndStackAddr packedValue) { return uint32_t(packedValue >> ThreadTagShift); }
+
+    // Reports expect the layout of BadAccessGuardShadow: pass an address of the current stack if the last write came from this thread, none otherwise.
+    static BA_GUARD_NO_INLINE StateAndStackAddr ToReportedOperation(StateAndStackAddr packedValue)
+    {
+        const bool fromThisThread = (packedValue & ThreadTagMask) == BadAccessGuardThreadTag();
+        const StateAndStackAddr inStackAddr = fromThisThread ? StateAndStackAddr(BA_GUARD_GET_PTR_IN_STACK()) : 0;
+        return (inStackAddr & InStackAddrMask) | StateAndStackAddr(GetState(packedValue));
+    }
+};
+
+template<typename T>
+struct BadAccessGuardTaggedPtr : BadAccessGuardTaggedPtrBase
+{
+    static_assert(alignof(T) >= StateMask + 1, "The state is stored in the lower bits of the pointer");
+
+    BadAccessGuardTaggedPtr(T* ptr = nullptr) { stateAndInStackAddr = ToPointerBits(ptr); }
+    // Copies the pointer, not the state of the other object
+    BadAccessGuardTaggedPtr(const BadAccessGuardTaggedPtr& other) : BadAccessGuardTaggedPtr(other.Get()) {}
+    BadAccessGuardTaggedPtr& operator=(const BadAccessGuardTaggedPtr& other) { Set(other.Get()); return *this; }
+
+    BA_GUARD_FORCE_INLINE T* Get() const { return reinterpret_cast<T*>(stateAndInStackAddr & PointerMask); }
+    BA_GUARD_FORCE_INLINE T* operator->() const { return Get(); }
+    BA_GUARD_FORCE_INLINE void Set(T* ptr)
+    {
+        const StateAndStackAddr packedValue = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(stateAndInStackAddr);
+        BA_GUARD_ATOMIC_RELAXED_STORE_UPTR(stateAndInStackAddr, (packedValue & ~PointerMask) | ToPointerBits(ptr));
+    }
+
+    BA_GUARD_FORCE_INLINE void SetStateAtomicRelaxed(BadAccessGuardState newState)
+    {
+        StateAndStackAddr threadTag = BadAccessGuardThreadTag();
+        if (!threadTag) BA_GUARD_UNLIKELY
+        {
+            threadTag = BadAccessGuardAcquireThreadTag();
+        }
+        const StateAndStackAddr packedValue = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(stateAndInStackAddr);
+        BA_GUARD_ATOMIC_RELAXED_STORE_UPTR(stateAndInStackAddr, (packedValue & PointerMask) | threadTag | StateAndStackAddr(newState));
+    }
+
+private:
+    // Storing the other bits would overwrite the state or the thread tag, and then be taken for a bad access.
+    static BA_GUARD_FORCE_INLINE StateAndStackAddr ToPointerBits(T* ptr)
+    {
+        if (StateAndStackAddr(ptr) & ~PointerMask) BA_GUARD_UNLIKELY
+        {
+            BAGuardHandleBadAccess(StateAndStackAddr(BAGuard_ReadingOrIdle), BAGuard_Writing, true,
+                "Pointer can not be stored in a BadAccessGuardTaggedPtr: its upper 16 bits must be 0 (no 5-level paging nor top byte tagging) and it must be aligned on 4 bytes.");
+        }
+        return StateAndStackAddr(ptr) & PointerMask;
+    }
+};
+
+#elif BAD_ACCESS_GUARDS_ENABLE
+
+template<typename T>
+struct BadAccessGuardTaggedPtr : BadAccessGuardShadow
+{
+    T* ptr;
+
+    BadAccessGuardTaggedPtr(T* ptr = nullptr) : ptr(ptr) {}
+    BadAccessGuardTaggedPtr(const BadAccessGuardTaggedPtr& other) : ptr(other.ptr) {}
+    BadAccessGuardTaggedPtr& operator=(const BadAccessGuardTaggedPtr& other) { ptr = other.ptr; return *this; }
+
+    BA_GUARD_FORCE_INLINE T* Get() const { return ptr; }
+    BA_GUARD_FORCE_INLINE T* operator->() const { return ptr; }
+    BA_GUARD_FORCE_INLINE void Set(T* newPtr) { ptr = newPtr; }
+};
+
+#else // BAD_ACCESS_GUARDS_ENABLE
+
+template<typename T>
+struct BadAccessGuardTaggedPtr
+{
+    T* ptr;
+
+    BadAccessGuardTaggedPtr(T* ptr = nullptr) : ptr(ptr) {}
+
+    T* Get() const { return ptr; }
+    T* operator->() const { return ptr; }
+    void Set(T* newPtr) { ptr = newPtr; }
+};
+
+#endif // BAD_ACCESS_GUARDS_ENABLE
+
+// Mutable like BA_GUARD_DECL, so that const methods can use read guards. Also a plain pointer when guards are disabled.
+#define BA_GUARD_TAGGED_PTR_DECL(TYPE,VARNAME)                  mutable BadAccessGuardTaggedPtr<TYPE> VARNAME
@@ -0,0 +1,106 @@
+﻿// BadAccessGuards v1.0.0 https://github.com/Lectem/BadAccessGuards
+#pragma once
+
+// Wraps an object so that all accesses go through guarded proxies, instead of adding `BA_GUARD_READ`/`BA_GUARD_WRITE` to each of its methods:
+//
+//     BadAccessGuarded<Settings> settings;
+//     int volume = settings.Read()->volume;     // Read guard for the duration of the expression
+//     {
+//         auto settingsWrite = settings.Write(); // Write guard until the end of the scope
+//         settingsWrite->volume = 11;
+//         settingsWrite->muted = false;
+//     }
+//
+// Proxies hold the guard for their whole lifetime, so keep them short lived: a proxy alive while another thread accesses the object is a bad access.
+// Everything is force inlined so that Debug builds pay the same price as hand-written guards.
+// Requires C++17, since proxies can't be copied nor moved. Below C++17 this header declares nothing but `BA_GUARDED_AVAILABLE` (0), so that it can be included unconditionally.
+
+#include "BadAccessGuards.h"
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+# define BA_GUARDED_AVAILABLE 1
+#else
+# define BA_GUARDED_AVAILABLE 0 // Guaranteed copy elision is needed to return the proxies
+#endif
+
+#if BA_GUARDED_AVAILABLE
+
+#if BAD_ACCESS_GUARDS_ENABLE
+# define BA_GUARDED_FORCE_INLINE BA_GUARD_FORCE_INLINE
+#else
+# define BA_GUARDED_FORCE_INLINE inline
+#endif
+
+template<typename T>
+class BadAccessGuarded
+{
+    T value;
+    BA_GUARD_DECL(BAShadow);
+public:
+    class ReadProxy
+    {
+#if BAD_ACCESS_GUARDS_ENABLE
+        BadAccessGuardRead guard;
+#endif
+        const T& value;
+        friend class BadAccessGuarded;
+#if BAD_ACCESS_GUARDS_ENABLE
+        BA_GUARDED_FORCE_INLINE ReadProxy(BadAccessGuardShadow& shadow, const T& value) : guard(shadow), value(value) {}
+#else
+        BA_GUARDED_FORCE_INLINE explicit ReadProxy(const T& value) : value(value) {}
+#endif
+    public:
+        ReadProxy(const ReadProxy&) = delete;
+        ReadProxy& operator=(const ReadProxy&) = delete;
+
+        BA_GUARDED_FORCE_INLINE const T* operator->() const { return &value; }
+        BA_GUARDED_FORCE_INLINE const T& operator*() const { return value; }
+    };
+
+    class WriteProxy
+    {
+#if BAD_ACCESS_GUARDS_ENABLE
+        BadAccessGuardWrite guard;
+#endif
+        T& value;
+        friend class BadAccessGuarded;
+#if BAD_ACCESS_GUARDS_ENABLE
+        BA_GUARDED_FORCE_INLINE WriteProxy(BadAccessGuardShadow& shadow, T& value) : guard(shadow), value(value) {}
+#else
+        BA_GUARDED_FORCE_INLINE explicit WriteProxy(T& value) : value(value) {}
+#endif
+    public:
+        WriteProxy(const WriteProxy&) = delete;
+        WriteProxy& operator=(const WriteProxy&) = delete;
+
+        BA_GUARDED_FORCE_INLINE T* operator->() const { return &value; }
+        BA_GUARDED_FORCE_INLINE T& operator*() const { return value; }
+    };
+
+    // Not a candidate for copies, which would otherwise prefer it to the deleted copy constructor for non-const lvalues.
+    template<typename... Args, typename = std::enable_if_t<!(std::is_same_v<std::decay_t<Args>, BadAccessGuarded> || ...)>>
+    explicit BadAccessGuarded(Args&&... args)
+        : value(std::forward<Args>(args)...)
+    {
+    }
+
+    ~BadAccessGuarded()
+    {
+        BA_GUARD_DESTROY(BAShadow);
+    }
+
+    BadAccessGuarded(const BadAccessGuarded&) = delete;
+    BadAccessGuarded& operator=(const BadAccessGuarded&) = delete;
+
+#if BAD_ACCESS_GUARDS_ENABLE
+    BA_GUARDED_FORCE_INLINE ReadProxy Read() const { return ReadProxy(BAShadow, value); }
+    BA_GUARDED_FORCE_INLINE WriteProxy Write() { return WriteProxy(BAShadow, value); }
+#else
+    BA_GUARDED_FORCE_INLINE ReadProxy Read() const { return ReadProxy(value); }
+    BA_GUARDED_FORCE_INLINE WriteProxy Write() { return WriteProxy(value); }
+#endif
+};
+
+#endif // BA_GUARDED_AVAILABLE
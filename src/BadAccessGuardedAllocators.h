@@ -0,0 +1,151 @@
+﻿// BadAccessGuards v1.0.0 https://github.com/Lectem/BadAccessGuards
+#pragma once
+
+// Non thread-safe allocators instrumented with the guards, so that using one of them from multiple threads at the same time gets reported.
+// Typical culprits are per-thread arenas or object pools that end up being shared across threads.
+// Both work on memory you provide and never allocate themselves. They are usable (unguarded) when `BAD_ACCESS_GUARDS_ENABLE=0`.
+
+#include "BadAccessGuards.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Linear (bump pointer) allocator. Allocations can't be freed individually, use `Reset` to release all of them at once.
+class BadAccessGuardedArena
+{
+    char* const begin;
+    char* const end;
+    char* current;
+    BA_GUARD_DECL(BAShadow);
+public:
+    BadAccessGuardedArena(void* buffer, size_t size)
+        : begin(static_cast<char*>(buffer))
+        , end(static_cast<char*>(buffer) + size)
+        , current(static_cast<char*>(buffer))
+    {
+    }
+
+    ~BadAccessGuardedArena()
+    {
+        BA_GUARD_DESTROY(BAShadow);
+    }
+
+    BadAccessGuardedArena(const BadAccessGuardedArena&) = delete;
+    BadAccessGuardedArena& operator=(const BadAccessGuardedArena&) = delete;
+
+    // Returns nullptr if there is not enough space left. `alignment` must be a power of 2.
+    void* Allocate(size_t size, size_t alignment = alignof(max_align_t))
+    {
+        BA_GUARD_WRITE(BAShadow);
+        const uintptr_t aligned = (uintptr_t(current) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (aligned > uintptr_t(end) || size > uintptr_t(end) - aligned)
+        {
+            return nullptr;
+        }
+        current = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void Reset()
+    {
+        BA_GUARD_WRITE(BAShadow);
+        current = begin;
+    }
+
+    size_t GetUsedSize() const
+    {
+        BA_GUARD_READ(BAShadow);
+        return size_t(current - begin);
+    }
+
+    size_t GetCapacity() const
+    {
+        return size_t(end - begin);
+    }
+};
+
+// Fixed size blocks allocator. Freed blocks are kept in an intrusive freelist, and never touched blocks are bump allocated.
+// This way, construction and `Reset` do not need to walk the whole buffer.
+class BadAccessGuardedPool
+{
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    char* const begin;
+    char* const end;
+    const size_t blockSize;
+    char* untouched; // Blocks after this one have never been allocated
+    FreeBlock* freeList;
+    BA_GUARD_DECL(BAShadow);
+
+    static size_t RoundBlockSize(size_t size)
+    {
+        // Blocks must be able to hold and align a freelist link
+        const size_t linkSize = sizeof(FreeBlock);
+        return size < linkSize ? linkSize : (size + linkSize - 1) / linkSize * linkSize;
+    }
+public:
+    // `buffer` must be aligned for `FreeBlock*` and the objects you will store in it.
+    BadAccessGuardedPool(void* buffer, size_t bufferSize, size_t blockSize)
+        : begin(static_cast<char*>(buffer))
+        , end(static_cast<char*>(buffer) + bufferSize / RoundBlockSize(blockSize) * RoundBlockSize(blockSize))
+        , blockSize(RoundBlockSize(blockSize))
+        , untouched(static_cast<char*>(buffer))
+        , freeList(nullptr)
+    {
+    }
+
+    ~BadAccessGuardedPool()
+    {
+        BA_GUARD_DESTROY(BAShadow);
+    }
+
+    BadAccessGuardedPool(const BadAccessGuardedPool&) = delete;
+    BadAccessGuardedPool& operator=(const BadAccessGuardedPool&) = delete;
+
+    // Returns nullptr if all blocks are in use.
+    void* Allocate()
+    {
+        BA_GUARD_WRITE(BAShadow);
+        if (FreeBlock* block = freeList)
+        {
+            freeList = block->next;
+            return block;
+        }
+        if (untouched == end)
+        {
+            return nullptr;
+        }
+        void* block = untouched;
+        untouched += blockSize;
+        return block;
+    }
+
+    void Free(void* ptr)
+    {
+        if (!ptr) return;
+        BA_GUARD_WRITE(BAShadow);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = freeList;
+        freeList = block;
+    }
+
+    // Releases all blocks at once
+    void Reset()
+    {
+        BA_GUARD_WRITE(BAShadow);
+        untouched = begin;
+        freeList = nullptr;
+    }
+
+    size_t GetBlockSize() const
+    {
+        return blockSize;
+    }
+
+    size_t GetBlockCount() const
+    {
+        return size_t(end - begin) / blockSize;
+    }
+};
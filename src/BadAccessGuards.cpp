@@ -36,6 +36,16 @@ bool IsAddressInStackSafe(NT_TIB* tib, void* ptr)
     }
 }
 
+bool GetCurrentStackBounds(uintptr_t& low, uintptr_t& high)
+{
+    // Unlike NT_TIB::StackLimit, this is the whole reserved stack and not only the part that was committed so far.
+    ULONG_PTR lowLimit, highLimit;
+    GetCurrentThreadStackLimits(&lowLimit, &highLimit);
+    low = uintptr_t(lowLimit);
+    high = uintptr_t(highLimit);
+    return true;
+}
+
 bool IsAddressInCurrentStack(void* ptr)
 {
     NT_TIB* tib = (NT_TIB*)NtCurrentTeb(); // NT_TEB starts with NT_TIB for all usermode threads. See ntddk.h.
@@ -111,21 +121,46 @@ uint64_t FindThreadWithPtrInStack(void* ptr, ThreadDescBuffer outDescription)
     return idOfThreadWithAddrInStack;
 }
 
+int BA_GUARD_NO_INLINE BadAccessGuardCaptureBacktrace(void** outFrames, int maxFrames, int skipFrames)
+{
+    // x64 code does not keep frame pointers, but RtlCaptureStackBackTrace uses the unwind tables and does not allocate.
+    return RtlCaptureStackBackTrace(DWORD(skipFrames + 1), DWORD(maxFrames), outFrames, nullptr); // +1 to skip this function
+}
+
 #elif defined(_GNU_SOURCE) && (_POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600) // Linux / POSIX
 
 #include <pthread.h>
-bool IsAddressInCurrentStack(void* ptr)
+bool GetCurrentStackBounds(uintptr_t& low, uintptr_t& high)
 {
-    // TODO: handle failure properly. For now return false on failure. (Assume this is a MT error)
-    pthread_attr_t attributes;
-    if (0 != pthread_getattr_np(pthread_self(), &attributes)) return false;
+    // Cached since pthread_getattr_np needs to parse /proc/self/maps for the main thread.
+    static thread_local uintptr_t tStackLow = 0;
+    static thread_local uintptr_t tStackHigh = 0;
+    if (tStackHigh == 0)
+    {
+        // TODO: handle failure properly. For now return false on failure. (Assume this is a MT error)
+        pthread_attr_t attributes;
+        if (0 != pthread_getattr_np(pthread_self(), &attributes)) return false;
 
-    void* stackAddr;
-    size_t stackSize;
-    if (0 != pthread_attr_getstack(&attributes, &stackAddr, &stackSize)) return false;
+        void* stackAddr;
+        size_t stackSize;
+        const bool gotStack = 0 == pthread_attr_getstack(&attributes, &stackAddr, &stackSize);
+        pthread_attr_destroy(&attributes);
+        if (!gotStack) return false;
+
+        // On POSIX, address is indeed the start address (what you would give if allocating yourself)
+        tStackLow = uintptr_t(stackAddr);
+        tStackHigh = uintptr_t(stackAddr) + stackSize;
+    }
+    low = tStackLow;
+    high = tStackHigh;
+    return true;
+}
 
-    // On POSIX, address is indeed the start address (what you would give if allocating yourself)
-    return stackAddr <= ptr && uintptr_t(ptr) < (uintptr_t(stackAddr) + stackSize);
+bool IsAddressInCurrentStack(void* ptr)
+{
+    uintptr_t stackLow, stackHigh;
+    if (!GetCurrentStackBounds(stackLow, stackHigh)) return false;
+    return stackLow <= uintptr_t(ptr) && uintptr_t(ptr) < stackHigh;
 }
 
 // There is no way to iterate threads and get their stack address + size.
@@ -140,6 +175,14 @@ uint64_t FindThreadWithPtrInStack(void* ptr, ThreadDescBuffer outDescription) {
 // Apple, why do you make it so hard to look for your posix_*_np functions... Just give us docs or something instead of having us dive into the darwin-libpthread code! Didn't bother going further and try to compile/run this.
 
 #include <pthread.h>
+bool GetCurrentStackBounds(uintptr_t& low, uintptr_t& high)
+{
+    pthread_t currentThread = pthread_self();
+    high = uintptr_t(pthread_get_stackaddr_np(currentThread));
+    low = high - pthread_get_stacksize_np(currentThread);
+    return true;
+}
+
 bool IsAddressInCurrentStack(void* ptr)
 {
     pthread_t currentThread = pthread_self();
@@ -155,12 +198,82 @@ uint64_t FindThreadWithPtrInStack(void* ptr, ThreadDescBuffer outDescription) {
 
 #else // Unknown platform, default to assuming race conditions.
 
+bool GetCurrentStackBounds(uintptr_t& low, uintptr_t& high) { return false; }
 bool IsAddressInCurrentStack(void* ptr) { return false; } // Who knows ?
 uint64_t FindThreadWithPtrInStack(void* ptr, ThreadDescBuffer outDescription) { outDescription[0] = '\0'; return 0; }
 
 #endif
 
-bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message);
+#ifndef _WIN32
+// Walk the frame pointers ourselves: no libunwind, no allocation, and cheap enough to be done for every report.
+// Each frame record is { caller frame pointer, return address }, on x86, x64 and AArch64 alike.
+// This means that this file (and ideally your code) should be compiled with `-fno-omit-frame-pointer`.
+int BA_GUARD_NO_INLINE BadAccessGuardCaptureBacktrace(void** outFrames, int maxFrames, int skipFrames)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__) || defined(__aarch64__))
+    uintptr_t stackLow, stackHigh;
+    if (!GetCurrentStackBounds(stackLow, stackHigh)) return 0;
+
+    void** frame = (void**)__builtin_frame_address(0);
+    int count = 0;
+    while (count < maxFrames)
+    {
+        // Never read outside of our own stack, a function without frame pointer may have left anything in the register.
+        if (uintptr_t(frame) < stackLow || uintptr_t(frame) + 2 * sizeof(void*) > stackHigh || (uintptr_t(frame) & (sizeof(void*) - 1)) != 0)
+            break;
+        void** const callerFrame = (void**)frame[0];
+        void* const returnAddress = frame[1];
+        if (!returnAddress) break;
+
+        if (skipFrames > 0) skipFrames--;
+        else outFrames[count++] = returnAddress;
+
+        if (callerFrame <= frame) break; // Stack grows downwards, so the caller frame must be above ours.
+        frame = callerFrame;
+    }
+    return count;
+#else
+    // Unknown frame layout, implement it for your platform if you need it!
+    (void)outFrames; (void)maxFrames; (void)skipFrames;
+    return 0;
+#endif
+}
+#endif
+
+#if UINTPTR_MAX > 0xFFFFFFFF
+#if defined(_WIN32)
+uint64_t GetCurrentProcessIdForTag() { return GetCurrentProcessId(); }
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+uint64_t GetCurrentProcessIdForTag() { return uint64_t(getpid()); }
+#else
+uint64_t GetCurrentProcessIdForTag() { return 0; } // All processes will get the same tag, reports will consider them as the same process.
+#endif
+
+StateAndStackAddr ComputeProcessTag()
+{
+    // Never 0, which is the tag of regular shadows
+    return StateAndStackAddr(GetCurrentProcessIdForTag() % 0xFFFF + 1) << BadAccessGuardSharedShadow::ProcessTagShift;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+StateAndStackAddr InitProcessTag()
+{
+    // The child of a fork has another pid, but would otherwise keep the tag of its parent.
+    pthread_atfork(nullptr, nullptr, [] { gBadAccessGuardProcessTag = ComputeProcessTag(); });
+    return ComputeProcessTag();
+}
+#else
+StateAndStackAddr InitProcessTag() { return ComputeProcessTag(); }
+#endif
+
+// Shared shadows written before this is initialized get a tag of 0, and will be reported as regular shadows.
+StateAndStackAddr gBadAccessGuardProcessTag = InitProcessTag();
+
+#endif
+
+bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace);
 
 BadAccessGuardConfig gBadAccessGuardConfig{
     true, // allowBreak
@@ -184,12 +297,459 @@ void BadAccessGuardSetConfig(BadAccessGuardConfig config)
 }
 
 
+BadAccessGuardSchedulingPointHook* gBadAccessGuardSchedulingPointHook = nullptr;
+void BadAccessGuardSetSchedulingPointHook(BadAccessGuardSchedulingPointHook* hook) { gBadAccessGuardSchedulingPointHook = hook; }
+// Defined even if BAD_ACCESS_GUARDS_SCHEDULING_POINTS is 0 for this file, so that it links with code that enables it.
+void BadAccessGuardSchedulingPoint(const BadAccessGuardShadow& shadow)
+{
+    if (gBadAccessGuardSchedulingPointHook) gBadAccessGuardSchedulingPointHook(shadow);
+}
+
 // Return true if you want to break (unless breakASAP is set)
 bool BadAccessGuardReport(bool assertionOrWarning, const char* fmt, ...);
-bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message)
+
+#include <stdio.h>
+void ReportBacktrace(bool assertionOrWarning, const BadAccessGuardBacktrace& backtrace)
+{
+    if (backtrace.count <= 0) return;
+
+    // Only raw addresses, symbolize them with your debugger or addr2line. Resolving symbols here would be too heavy.
+    char buffer[sizeof(backtrace.frames) / sizeof(backtrace.frames[0]) * 32];
+    int length = 0;
+    for (int i = 0; i < backtrace.count && length < int(sizeof(buffer)); i++)
+    {
+        length += snprintf(buffer + length, sizeof(buffer) - length, "\n  #%-2d %p", i, backtrace.frames[i]);
+    }
+    BadAccessGuardReport(assertionOrWarning, "- Backtrace:%s", buffer);
+}
+
+#if BAD_ACCESS_GUARDS_FLIGHT_RECORDER
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+BA_GUARD_THREAD_LOCAL BadAccessGuardFlightRing* tBadAccessGuardFlightRing = nullptr;
+
+struct FlightRingNode
+{
+    BadAccessGuardFlightRing ring;
+    FlightRingNode* next;
+    uint32_t threadIndex;
+    std::atomic<bool> inUse;
+};
+// Lock-free list of all the rings. Rings are reused by new threads but never freed, so that dumping never reads freed memory.
+std::atomic<FlightRingNode*> gFlightRings{ nullptr };
+std::atomic<uint32_t> gFlightThreadCount{ 0 };
+
+// Releases the ring when the thread exits, the history of the thread is kept until another thread reuses it.
+struct FlightRingOwner
+{
+    FlightRingNode* node = nullptr;
+    ~FlightRingOwner()
+    {
+        if (!node) return;
+        // Guards used by later thread_local destructors will register another ring, which is leaked.
+        tBadAccessGuardFlightRing = nullptr;
+        node->inUse.store(false, std::memory_order_release);
+    }
+};
+thread_local FlightRingOwner tFlightRingOwner;
+
+BadAccessGuardFlightRing* BA_GUARD_NO_INLINE BadAccessGuardAcquireFlightRing()
+{
+    FlightRingNode* node = nullptr;
+    for (FlightRingNode* it = gFlightRings.load(std::memory_order_acquire); it && !node; it = it->next)
+    {
+        bool expected = false;
+        if (!it->inUse.load(std::memory_order_relaxed) && it->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            node = it;
+        }
+    }
+    if (!node)
+    {
+        node = new FlightRingNode{};
+        node->inUse.store(true, std::memory_order_relaxed);
+        node->next = gFlightRings.load(std::memory_order_relaxed);
+        while (!gFlightRings.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+    node->ring.nbRecorded = 0;
+    node->threadIndex = gFlightThreadCount.fetch_add(1, std::memory_order_relaxed);
+    tFlightRingOwner.node = node;
+    tBadAccessGuardFlightRing = &node->ring;
+    return &node->ring;
+}
+
+std::atomic<uint64_t> gFlightClock{ 0 };
+uint64_t BadAccessGuardFlightClock() { return gFlightClock.fetch_add(1, std::memory_order_relaxed); }
+
+void BadAccessGuardDumpFlightRecorder(bool assertionOrWarning)
+{
+    struct MergedEntry
+    {
+        BadAccessGuardFlightEntry entry;
+        uint32_t threadIndex;
+    };
+    const BadAccessGuardFlightRing* const currentRing = tBadAccessGuardFlightRing;
+    uint32_t currentThreadIndex = 0;
+    uint32_t nbThreads = 0;
+
+    // Other threads keep recording while we copy their rings, so the oldest entries of a ring may already be overwritten by newer ones.
+    // Entries may also be torn, this is only meant as a hint.
+    std::vector<MergedEntry> merged;
+    for (FlightRingNode* node = gFlightRings.load(std::memory_order_acquire); node; node = node->next)
+    {
+        const uint64_t nbRecorded = node->ring.nbRecorded;
+        const uint64_t nbEntries = nbRecorded < BAD_ACCESS_GUARDS_FLIGHT_RECORDER ? nbRecorded : BAD_ACCESS_GUARDS_FLIGHT_RECORDER;
+        if (nbEntries == 0) continue;
+        nbThreads++;
+        if (&node->ring == currentRing) currentThreadIndex = node->threadIndex;
+        for (uint64_t i = nbRecorded - nbEntries; i < nbRecorded; i++)
+        {
+            merged.push_back({ node->ring.entries[i & (BAD_ACCESS_GUARDS_FLIGHT_RECORDER - 1)], node->threadIndex });
+        }
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const MergedEntry& lhs, const MergedEntry& rhs) { return lhs.entry.timestamp < rhs.entry.timestamp; });
+
+    const char* opToStr[] = { "Read", "WriteBegin", "WriteEnd", "Destroy", "Freeze" };
+    BadAccessGuardReport(assertionOrWarning, "- Flight recorder: last %zu guard operations of %u thread(s), oldest first. This thread is #%u.", merged.size(), nbThreads, currentThreadIndex);
+    for (const MergedEntry& merge : merged)
+    {
+        const BadAccessGuardFlightEntry& entry = merge.entry;
+        const char* const op = entry.operation < sizeof(opToStr) / sizeof(opToStr[0]) ? opToStr[entry.operation] : "<Corrupted>";
+        BadAccessGuardReport(assertionOrWarning, "  %20llu #%-3u %-10s shadow=%p from %p", (unsigned long long)entry.timestamp, merge.threadIndex, op, (const void*)entry.shadow, entry.returnAddress);
+    }
+}
+#else
+void BadAccessGuardDumpFlightRecorder(bool) {}
+#endif
+
+#if BAD_ACCESS_GUARDS_CENSUS
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if !defined(BA_GUARD_CENSUS_TABLE_SIZE)
+# define BA_GUARD_CENSUS_TABLE_SIZE 4096 // Max number of objects tracked by the census, must be a power of 2
+#endif
+static_assert((BA_GUARD_CENSUS_TABLE_SIZE & (BA_GUARD_CENSUS_TABLE_SIZE - 1)) == 0, "BA_GUARD_CENSUS_TABLE_SIZE must be a power of 2");
+
+BA_GUARD_THREAD_LOCAL uintptr_t tBadAccessGuardCensusStackLow = 0;
+BA_GUARD_THREAD_LOCAL uintptr_t tBadAccessGuardCensusStackSize = 0;
+BA_GUARD_THREAD_LOCAL uint32_t tCensusSampleCountdown = 0;
+
+// Open addressing side table keyed by shadow address, slots are never removed (except by BadAccessGuardResetCensus).
+// An object destroyed and another one allocated at the same address will share a slot.
+struct CensusSlot
+{
+    std::atomic<const BadAccessGuardShadow*> shadow;
+    std::atomic<void*> firstReturnAddress;
+    std::atomic<uint64_t> nbSamples;
+};
+CensusSlot gCensusTable[BA_GUARD_CENSUS_TABLE_SIZE];
+std::atomic<uint64_t> gCensusNbDropped{ 0 }; // Samples lost because the table was full
+
+void BA_GUARD_NO_INLINE BadAccessGuardCensusHandoff(const BadAccessGuardShadow& shadow, uintptr_t previousInStackAddr, void* returnAddress)
+{
+    if (tBadAccessGuardCensusStackSize == 0) // First check for this thread
+    {
+        uintptr_t stackLow, stackHigh;
+        if (GetCurrentStackBounds(stackLow, stackHigh))
+        {
+            tBadAccessGuardCensusStackLow = stackLow;
+            tBadAccessGuardCensusStackSize = stackHigh - stackLow;
+        }
+        else
+        {
+            // Unknown stack, never report handoffs
+            tBadAccessGuardCensusStackLow = 0;
+            tBadAccessGuardCensusStackSize = UINTPTR_MAX;
+        }
+        if (previousInStackAddr - tBadAccessGuardCensusStackLow < tBadAccessGuardCensusStackSize) return;
+    }
+    if (previousInStackAddr == 0) return; // First write to this object
+
+    if (tCensusSampleCountdown != 0)
+    {
+        tCensusSampleCountdown--;
+        return;
+    }
+    tCensusSampleCountdown = BAD_ACCESS_GUARDS_CENSUS - 1;
+
+    const size_t hash = size_t((uint64_t(uintptr_t(&shadow)) * 0x9E3779B97F4A7C15ull) >> 32);
+    for (size_t probe = 0; probe < BA_GUARD_CENSUS_TABLE_SIZE; probe++)
+    {
+        CensusSlot& slot = gCensusTable[(hash + probe) & (BA_GUARD_CENSUS_TABLE_SIZE - 1)];
+        const BadAccessGuardShadow* slotShadow = slot.shadow.load(std::memory_order_relaxed);
+        if (!slotShadow && slot.shadow.compare_exchange_strong(slotShadow, &shadow, std::memory_order_relaxed))
+        {
+            slot.firstReturnAddress.store(returnAddress, std::memory_order_relaxed);
+            slotShadow = &shadow;
+        }
+        if (slotShadow == &shadow)
+        {
+            slot.nbSamples.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    gCensusNbDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+int BadAccessGuardGetCensus(BadAccessGuardCensusEntry* outEntries, int maxEntries)
+{
+    std::vector<BadAccessGuardCensusEntry> entries;
+    for (const CensusSlot& slot : gCensusTable)
+    {
+        const BadAccessGuardShadow* const shadow = slot.shadow.load(std::memory_order_relaxed);
+        if (!shadow) continue;
+        entries.push_back({ shadow, slot.firstReturnAddress.load(std::memory_order_relaxed), slot.nbSamples.load(std::memory_order_relaxed) * BAD_ACCESS_GUARDS_CENSUS });
+    }
+    std::sort(entries.begin(), entries.end(), [](const BadAccessGuardCensusEntry& lhs, const BadAccessGuardCensusEntry& rhs) { return lhs.nbHandoffs > rhs.nbHandoffs; });
+
+    const int nbEntries = int(entries.size()) < maxEntries ? int(entries.size()) : maxEntries;
+    std::copy(entries.begin(), entries.begin() + nbEntries, outEntries);
+    return nbEntries;
+}
+
+void BadAccessGuardDumpCensus(int maxEntries)
+{
+    std::vector<BadAccessGuardCensusEntry> entries(maxEntries > 0 ? size_t(maxEntries) : 0);
+    const int nbEntries = BadAccessGuardGetCensus(entries.data(), maxEntries);
+    BadAccessGuardReport(false, "Census: top %d object(s) handed off between threads, 1 out of %d handoffs sampled.", nbEntries, BAD_ACCESS_GUARDS_CENSUS);
+    for (int i = 0; i < nbEntries; i++)
+    {
+        BadAccessGuardReport(false, "  #%-3d shadow=%p ~%llu handoffs, first seen from %p", i + 1, (const void*)entries[i].shadow, (unsigned long long)entries[i].nbHandoffs, entries[i].firstReturnAddress);
+    }
+    if (const uint64_t nbDropped = gCensusNbDropped.load(std::memory_order_relaxed))
+    {
+        BadAccessGuardReport(false, "  %llu samples dropped, the table is full. Increase BA_GUARD_CENSUS_TABLE_SIZE.", (unsigned long long)nbDropped);
+    }
+}
+
+// Not synchronized with guards running at the same time, some samples may end up in the wrong slot.
+void BadAccessGuardResetCensus()
+{
+    for (CensusSlot& slot : gCensusTable)
+    {
+        slot.nbSamples.store(0, std::memory_order_relaxed);
+        slot.firstReturnAddress.store(nullptr, std::memory_order_relaxed);
+        slot.shadow.store(nullptr, std::memory_order_relaxed);
+    }
+    gCensusNbDropped.store(0, std::memory_order_relaxed);
+}
+#else
+int BadAccessGuardGetCensus(BadAccessGuardCensusEntry*, int) { return 0; }
+void BadAccessGuardDumpCensus(int) {}
+void BadAccessGuardResetCensus() {}
+#endif
+
+#if BAD_ACCESS_GUARDS_AMPLIFY
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if !defined(BA_GUARD_AMPLIFY_TABLE_SIZE)
+# define BA_GUARD_AMPLIFY_TABLE_SIZE 1024 // Number of per-site delay scales, must be a power of 2
+#endif
+static_assert((BA_GUARD_AMPLIFY_TABLE_SIZE & (BA_GUARD_AMPLIFY_TABLE_SIZE - 1)) == 0, "BA_GUARD_AMPLIFY_TABLE_SIZE must be a power of 2");
+
+BadAccessGuardAmplifyConfig gAmplifyConfig{ BAGuardAmplify_Spin, 2000, 0.25f };
+// Delay of a site is shifted right by its backoff. Indexed by the hash of the return address, without keys: colliding sites share their backoff.
+std::atomic<uint8_t> gAmplifyBackoffs[BA_GUARD_AMPLIFY_TABLE_SIZE];
+const uint8_t AmplifyMaxBackoff = 6;
+const uint32_t AmplifyBackoffOneIn = 16; // Quiet windows needed (on average) to back off one step
+// Detections anywhere count as a conflict for the windows open at that time.
+std::atomic<uint64_t> gAmplifyNbDetections{ 0 };
+
+struct AmplifyThreadState
+{
+    int64_t startNs;
+    int64_t waitedNs; // Includes our own overhead
+    uint64_t rngState;
+    uint32_t nbToSkip; // Writes left to skip before the next delay, without even reading the clock
+    uint32_t skipInterval; // Doubles while over budget, halves otherwise
+};
+thread_local AmplifyThreadState tAmplify{ 0, 0, 0, 0, 0 };
+const uint32_t AmplifyMaxSkipInterval = 1 << 16;
+
+int64_t AmplifyNowNs()
+{
+    return int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t AmplifyNextRandom(uint64_t& state)
+{
+    // splitmix64
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+BadAccessGuardAmplifyConfig BadAccessGuardGetAmplifyConfig() { return gAmplifyConfig; }
+void BadAccessGuardSetAmplifyConfig(BadAccessGuardAmplifyConfig config) { gAmplifyConfig = config; }
+
+void BA_GUARD_NO_INLINE BadAccessGuardAmplify(const BadAccessGuardShadow& shadow, void* returnAddress)
+{
+    const BadAccessGuardAmplifyConfig config = gAmplifyConfig;
+    if (config.mode == BAGuardAmplify_Off || config.maxDelayNs == 0) return;
+
+    AmplifyThreadState& thread = tAmplify;
+    if (thread.nbToSkip != 0)
+    {
+        thread.nbToSkip--;
+        return;
+    }
+    const int64_t startNs = AmplifyNowNs();
+    if (thread.startNs == 0) // First guarded write of this thread
+    {
+        thread.startNs = startNs;
+        thread.rngState = uint64_t(uintptr_t(&thread)) ^ uint64_t(startNs);
+    }
+    if (double(thread.waitedNs) > double(config.budget) * double(startNs - thread.startNs))
+    {
+        thread.skipInterval = thread.skipInterval * 2 + 1 < AmplifyMaxSkipInterval ? thread.skipInterval * 2 + 1 : AmplifyMaxSkipInterval;
+        thread.nbToSkip = thread.skipInterval;
+        thread.waitedNs += AmplifyNowNs() - startNs;
+        return;
+    }
+    thread.skipInterval /= 2;
+    thread.nbToSkip = thread.skipInterval;
+
+    std::atomic<uint8_t>& backoff = gAmplifyBackoffs[size_t((uint64_t(uintptr_t(returnAddress)) * 0x9E3779B97F4A7C15ull) >> 32) & (BA_GUARD_AMPLIFY_TABLE_SIZE - 1)];
+    const uint8_t siteBackoff = backoff.load(std::memory_order_relaxed);
+    const uint64_t random = AmplifyNextRandom(thread.rngState);
+    const int64_t delayNs = int64_t(((random & 0xFFFFFFFF) % (uint64_t(config.maxDelayNs) + 1)) >> siteBackoff);
+
+    const StateAndStackAddr ourWrite = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
+    const uint64_t nbDetectionsBefore = gAmplifyNbDetections.load(std::memory_order_relaxed);
+    const int64_t deadlineNs = startNs + delayNs;
+    switch (config.mode)
+    {
+    case BAGuardAmplify_Spin:
+        while (AmplifyNowNs() < deadlineNs) {}
+        break;
+    case BAGuardAmplify_Yield:
+        do { std::this_thread::yield(); } while (AmplifyNowNs() < deadlineNs);
+        break;
+    case BAGuardAmplify_Sleep:
+        std::this_thread::sleep_for(std::chrono::nanoseconds(delayNs));
+        break;
+    default:
+        break;
+    }
+    thread.waitedNs += AmplifyNowNs() - startNs;
+
+    // Another write (or destruction) overwrote the shadow, or someone detected a bad access while we were waiting
+    const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
+    if (lastSeenOp != ourWrite || gAmplifyNbDetections.load(std::memory_order_relaxed) != nbDetectionsBefore)
+    {
+        if (siteBackoff != 0) backoff.store(0, std::memory_order_relaxed);
+    }
+    else if (siteBackoff < AmplifyMaxBackoff && (random >> 32) % AmplifyBackoffOneIn == 0)
+    {
+        backoff.store(uint8_t(siteBackoff + 1), std::memory_order_relaxed);
+    }
+}
+#else
+BadAccessGuardAmplifyConfig BadAccessGuardGetAmplifyConfig() { return { BAGuardAmplify_Off, 0, 0.f }; }
+void BadAccessGuardSetAmplifyConfig(BadAccessGuardAmplifyConfig) {}
+#endif
+
+#if BAD_ACCESS_GUARDS_WRITE_STACK
+BA_GUARD_THREAD_LOCAL BadAccessGuardWriteStack tBadAccessGuardWriteStack = {};
+
+void ReportLeakedWriteGuards(const char* when, uint32_t first, uint32_t last)
+{
+    BadAccessGuardReport(true, "Write guard(s) never ended, %s: their object stays in the writing state. Was the guard skipped by longjmp, or held across a fiber switch?", when);
+    for (uint32_t i = first; i < last && i < BAD_ACCESS_GUARDS_WRITE_STACK; i++)
+    {
+        const BadAccessGuardWriteStackEntry& entry = tBadAccessGuardWriteStack.entries[i];
+        BadAccessGuardReport(true, "  #%-3u shadow=%p from %p", i, entry.shadow, entry.returnAddress);
+    }
+    if (last > BAD_ACCESS_GUARDS_WRITE_STACK) BadAccessGuardReport(true, "  ... and %u deeper guard(s), not stored.", last - (first > BAD_ACCESS_GUARDS_WRITE_STACK ? first : BAD_ACCESS_GUARDS_WRITE_STACK));
+}
+
+// Checks the stack of the thread when it exits. Registered by the first push of the thread, so that the stack itself has no constructor nor destructor and stays cheap to access.
+struct WriteStackExitCheck
+{
+    bool registered = false;
+    ~WriteStackExitCheck()
+    {
+        BadAccessGuardWriteStack& stack = tBadAccessGuardWriteStack;
+        if (stack.depth == 0) return;
+        ReportLeakedWriteGuards("at thread exit", 0, stack.depth);
+        stack.depth = 0; // Guards used by later thread_local destructors are still tracked, but not checked anymore
+    }
+};
+thread_local WriteStackExitCheck tWriteStackExitCheck;
+
+void BA_GUARD_NO_INLINE BadAccessGuardWriteStackPushSlow(const void* shadow, void* returnAddress)
+{
+    BadAccessGuardWriteStack& stack = tBadAccessGuardWriteStack;
+    if (stack.capacity == 0)
+    {
+        tWriteStackExitCheck.registered = true;
+        stack.capacity = BAD_ACCESS_GUARDS_WRITE_STACK;
+    }
+    if (stack.depth < stack.capacity)
+    {
+        stack.entries[stack.depth] = { shadow, returnAddress };
+    }
+    stack.depth++;
+}
+
+void BA_GUARD_NO_INLINE BadAccessGuardWriteStackPopSlow(const void* shadow)
+{
+    BadAccessGuardWriteStack& stack = tBadAccessGuardWriteStack;
+    if (stack.depth == 0) return; // Already reported at thread exit
+    if (stack.depth > BAD_ACCESS_GUARDS_WRITE_STACK)
+    {
+        stack.depth--; // Not stored, trust it
+        return;
+    }
+    for (uint32_t i = stack.depth - 1; i-- > 0;)
+    {
+        if (stack.entries[i].shadow == shadow)
+        {
+            ReportLeakedWriteGuards("when an outer write guard ended", i + 1, stack.depth);
+            stack.depth = i;
+            return;
+        }
+    }
+    // Not found: this guard was pushed past the capacity and the stack shrank since, can't tell which guards were skipped.
+    stack.depth--;
+}
+
+void BadAccessGuardDumpWriteStack(bool assertionOrWarning)
+{
+    const BadAccessGuardWriteStack& stack = tBadAccessGuardWriteStack;
+    if (stack.depth == 0) return;
+    BadAccessGuardReport(assertionOrWarning, "- Active write guards of this thread, outermost first:");
+    for (uint32_t i = 0; i < stack.depth && i < BAD_ACCESS_GUARDS_WRITE_STACK; i++)
+    {
+        BadAccessGuardReport(assertionOrWarning, "  #%-3u shadow=%p from %p", i, stack.entries[i].shadow, stack.entries[i].returnAddress);
+    }
+    if (stack.depth > BAD_ACCESS_GUARDS_WRITE_STACK) BadAccessGuardReport(assertionOrWarning, "  ... and %u deeper guard(s), not stored. Increase BAD_ACCESS_GUARDS_WRITE_STACK.", stack.depth - BAD_ACCESS_GUARDS_WRITE_STACK);
+}
+#else
+void BadAccessGuardDumpWriteStack(bool) {}
+#endif
+
+bool DefaultReportBadAccessMessage(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message)
 {
     const BadAccessGuardState previousState = BadAccessGuardShadow::GetState(previousOperation);
-    const bool fromSameThread = IsAddressInCurrentStack(BadAccessGuardShadow::GetInStackAddr(previousOperation));
+#if UINTPTR_MAX > 0xFFFFFFFF
+    // Regular shadows have a tag of 0, so this works for both kinds of shadows.
+    const uint32_t processTag = BadAccessGuardSharedShadow::GetProcessTag(previousOperation);
+    const bool fromOtherProcess = processTag != 0 && processTag != BadAccessGuardSharedShadow::GetProcessTag(gBadAccessGuardProcessTag);
+    void* const inStackAddr = BadAccessGuardSharedShadow::GetInStackAddr(previousOperation);
+#else
+    const uint32_t processTag = 0;
+    const bool fromOtherProcess = false;
+    void* const inStackAddr = BadAccessGuardShadow::GetInStackAddr(previousOperation);
+#endif
+    const bool fromSameThread = !fromOtherProcess && IsAddressInCurrentStack(inStackAddr);
     if (message)
     {
         return BadAccessGuardReport(assertionOrWarning, message);
@@ -203,11 +763,28 @@ bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardS
         const char* stateToStr[] = {
             toState == BAGuard_Writing ? "Writing" : "Reading", // The only cases when we can see this state are when we try to read, or in the writing guard destructor which means another write ended before. So we know that it can only be due to a write (or corruption).
             "Writing",
+            toState == BAGuard_Frozen ? "Freezing" : "Frozen",
             "Destroyed"
         };
         static_assert(sizeof(stateToStr) / sizeof(stateToStr[0]) == BAGuard_StatesCount, "Mismatch, new state added ?");
 
-        if (fromSameThread)
+        if (previousState == BAGuard_Frozen)
+        {
+            // Not a race, the write is wrong whenever it happens. The stack address is the one of the thread that froze the object, which may be long gone.
+            return BadAccessGuardReport(assertionOrWarning, "Write to a frozen object: it must only be read after BA_GUARD_FREEZE!\n- This thread: %s.", stateToStr[toState]);
+        }
+        else if (fromOtherProcess)
+        {
+            // The stack address is meaningless in this process, don't try to find the thread.
+            return BadAccessGuardReport(assertionOrWarning,
+                "Race condition: Multiple processes are reading/writing to the shared data at the same time, potentially corrupting it!\n- Other process: %s (process tag %u)\n- This process: %s (process tag %u).",
+                stateToStr[previousState],
+                processTag,
+                stateToStr[toState],
+                BadAccessGuardSharedShadow::GetProcessTag(gBadAccessGuardProcessTag)
+            );
+        }
+        else if (fromSameThread)
         {
 
             return BadAccessGuardReport(assertionOrWarning, "Recursion detected: This may lead to invalid operations\n- Parent operation: %s.\n- This operation: %s.", stateToStr[previousState], stateToStr[toState]);
@@ -215,7 +792,7 @@ bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardS
         else
         {
             ThreadDescBuffer outDescription;
-            uint64_t otherThreadId = FindThreadWithPtrInStack(BadAccessGuardShadow::GetInStackAddr(previousOperation), outDescription);
+            uint64_t otherThreadId = FindThreadWithPtrInStack(inStackAddr, outDescription);
             return BadAccessGuardReport(assertionOrWarning,
                 "Race condition: Multiple threads are reading/writing to the data at the same time, potentially corrupting it!\n- Other thread: %s (Desc=%s Id=%llu)\n- This thread: %s.",
                 stateToStr[previousState],
@@ -229,21 +806,489 @@ bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardS
     }
 }
 
-void BA_GUARD_NO_INLINE BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message)
+bool DefaultReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace)
+{
+    const bool shouldBreak = DefaultReportBadAccessMessage(previousOperation, toState, site.assertionOrWarning, site.message);
+    if (site.file)
+    {
+        BadAccessGuardReport(site.assertionOrWarning, "- Site: %s:%d in %s (%s)", site.file, site.line, site.function ? site.function : "<Unknown>", site.typeName ? site.typeName : "<Unknown type>");
+    }
+    ReportBacktrace(site.assertionOrWarning, backtrace);
+    return shouldBreak;
+}
+
+#if !defined(BA_GUARD_MAX_SUPPRESSIONS)
+# define BA_GUARD_MAX_SUPPRESSIONS 256 // Max number of site/function/type rules, and separately of address range rules
+#endif
+#if !defined(BA_GUARD_SUPPRESSIONS_TEXT_SIZE)
+# define BA_GUARD_SUPPRESSIONS_TEXT_SIZE 16384 // Storage for the names used by rules
+#endif
+#if !defined(BA_GUARD_SUPPRESSIONS_FROM_ENV)
+# define BA_GUARD_SUPPRESSIONS_FROM_ENV 0 // Set to 1 to also load rules from the environment, on the first bad access
+#endif
+
+#if defined(_MSC_VER)
+# define BA_GUARD_ATOMIC_INCREMENT_U64(var) _InterlockedIncrement64(reinterpret_cast<volatile long long*>(&(var)))
+#else
+# define BA_GUARD_ATOMIC_INCREMENT_U64(var) __atomic_add_fetch(&(var), 1, __ATOMIC_RELAXED)
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+enum SuppressionKind : int
+{
+    Suppression_Site,
+    Suppression_Function,
+    Suppression_Type,
+};
+static const char* const suppressionKindToStr[] = { "site", "function", "type" };
+
+struct SuppressionRule
+{
+    const char* name; // Points in gSuppressionText
+    size_t nameLength;
+    int line; // Site rules only
+    SuppressionKind kind;
+    uint64_t nbHits;
+};
+
+struct AddressSuppressionRule
+{
+    uintptr_t begin;
+    uintptr_t end;
+    uint64_t nbHits;
+};
+
+// Everything is statically allocated, so that the default build still does not depend on the C++ standard library.
+// Name rules live in an open addressing hash table, twice as big as the max number of rules so that probing stays short.
+SuppressionRule gSuppressionRules[BA_GUARD_MAX_SUPPRESSIONS];
+int gNbSuppressionRules = 0;
+int16_t gSuppressionTable[BA_GUARD_MAX_SUPPRESSIONS * 2]; // Index + 1 in gSuppressionRules, 0 if empty
+static_assert(BA_GUARD_MAX_SUPPRESSIONS < 0x7FFF, "Indices are stored as int16_t");
+AddressSuppressionRule gAddressSuppressionRules[BA_GUARD_MAX_SUPPRESSIONS];
+int gNbAddressSuppressionRules = 0;
+char gSuppressionText[BA_GUARD_SUPPRESSIONS_TEXT_SIZE];
+size_t gSuppressionTextSize = 0;
+uint64_t gNbSuppressed = 0;
+
+uint64_t HashSuppression(SuppressionKind kind, const char* name, size_t nameLength, int line)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull ^ uint64_t(kind);
+    for (size_t i = 0; i < nameLength; i++)
+    {
+        hash = (hash ^ uint8_t(name[i])) * 0x100000001b3ull;
+    }
+    return (hash ^ uint64_t(uint32_t(line))) * 0x100000001b3ull;
+}
+
+SuppressionRule* FindSuppression(SuppressionKind kind, const char* name, size_t nameLength, int line)
+{
+    const size_t tableSize = sizeof(gSuppressionTable) / sizeof(gSuppressionTable[0]);
+    const uint64_t hash = HashSuppression(kind, name, nameLength, line);
+    for (size_t probe = 0; probe < tableSize; probe++)
+    {
+        const int16_t index = gSuppressionTable[(hash + probe) % tableSize];
+        if (index == 0) return nullptr;
+        SuppressionRule& rule = gSuppressionRules[index - 1];
+        if (rule.kind == kind && rule.line == line && rule.nameLength == nameLength && !memcmp(rule.name, name, nameLength)) return &rule;
+    }
+    return nullptr;
+}
+
+enum AddSuppressionResult
+{
+    SuppressionAdd_Added,
+    SuppressionAdd_Duplicate, // Same as an existing rule, which is kept: no slot is used
+    SuppressionAdd_Invalid, // Or no slot left
+};
+
+AddSuppressionResult AddSuppression(SuppressionKind kind, const char* name, size_t nameLength, int line)
+{
+    if (FindSuppression(kind, name, nameLength, line)) return SuppressionAdd_Duplicate;
+    if (gNbSuppressionRules == BA_GUARD_MAX_SUPPRESSIONS || gSuppressionTextSize + nameLength > sizeof(gSuppressionText)) return SuppressionAdd_Invalid;
+
+    SuppressionRule& rule = gSuppressionRules[gNbSuppressionRules++];
+    rule.name = gSuppressionText + gSuppressionTextSize;
+    rule.nameLength = nameLength;
+    rule.line = line;
+    rule.kind = kind;
+    rule.nbHits = 0;
+    memcpy(gSuppressionText + gSuppressionTextSize, name, nameLength);
+    gSuppressionTextSize += nameLength;
+
+    const size_t tableSize = sizeof(gSuppressionTable) / sizeof(gSuppressionTable[0]);
+    const uint64_t hash = HashSuppression(kind, name, nameLength, line);
+    for (size_t probe = 0; ; probe++) // Can't be full, the table is twice as big as the max number of rules
+    {
+        int16_t& index = gSuppressionTable[(hash + probe) % tableSize];
+        if (index == 0)
+        {
+            index = int16_t(gNbSuppressionRules);
+            return SuppressionAdd_Added;
+        }
+    }
+}
+
+const char* FileNameWithoutDirectory(const char* path)
+{
+    const char* fileName = path;
+    for (const char* c = path; *c; c++)
+    {
+        if (*c == '/' || *c == '\\') fileName = c + 1;
+    }
+    return fileName;
+}
+
+AddSuppressionResult ParseSuppression(const char* rule, size_t length)
+{
+    auto startsWith = [&](const char* prefix) { const size_t prefixLength = strlen(prefix); return length > prefixLength && !memcmp(rule, prefix, prefixLength); };
+    if (startsWith("site:"))
+    {
+        // The line is after the last ':', file names may contain some (drive letters)
+        const char* const name = rule + 5;
+        const char* separator = rule + length - 1;
+        while (separator > name && *separator != ':') separator--;
+        if (separator == name) return SuppressionAdd_Invalid;
+        char* lineEnd;
+        const long line = strtol(separator + 1, &lineEnd, 10);
+        if (lineEnd != rule + length || line <= 0) return SuppressionAdd_Invalid;
+        const char* const fileName = FileNameWithoutDirectory(name);
+        if (fileName > separator) return SuppressionAdd_Invalid;
+        return AddSuppression(Suppression_Site, fileName, size_t(separator - fileName), int(line));
+    }
+    if (startsWith("function:")) return AddSuppression(Suppression_Function, rule + 9, length - 9, 0);
+    if (startsWith("type:")) return AddSuppression(Suppression_Type, rule + 5, length - 5, 0);
+    if (startsWith("addr:"))
+    {
+        char* beginEnd;
+        const unsigned long long begin = strtoull(rule + 5, &beginEnd, 16);
+        if (*beginEnd != '-') return SuppressionAdd_Invalid;
+        char* endEnd;
+        const unsigned long long end = strtoull(beginEnd + 1, &endEnd, 16);
+        if (endEnd != rule + length || end <= begin) return SuppressionAdd_Invalid;
+        for (int i = 0; i < gNbAddressSuppressionRules; i++)
+        {
+            if (gAddressSuppressionRules[i].begin == uintptr_t(begin) && gAddressSuppressionRules[i].end == uintptr_t(end)) return SuppressionAdd_Duplicate;
+        }
+        if (gNbAddressSuppressionRules == BA_GUARD_MAX_SUPPRESSIONS) return SuppressionAdd_Invalid;
+        gAddressSuppressionRules[gNbAddressSuppressionRules++] = { uintptr_t(begin), uintptr_t(end), 0 };
+        return SuppressionAdd_Added;
+    }
+    return SuppressionAdd_Invalid;
+}
+
+int BadAccessGuardAddSuppressions(const char* rules)
+{
+    int nbAdded = 0;
+    while (rules && *rules)
+    {
+        const char* lineEnd = rules;
+        while (*lineEnd && *lineEnd != '\n' && *lineEnd != ';') lineEnd++;
+        const char* begin = rules;
+        const char* end = lineEnd;
+        for (const char* c = begin; c < end; c++) // Strip comments
+        {
+            if (*c == '#') { end = c; break; }
+        }
+        while (begin < end && (*begin == ' ' || *begin == '\t')) begin++;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+
+        if (begin != end)
+        {
+            // Rules are small, copy them to have a null terminated string for strtol & co.
+            char rule[1024];
+            const size_t length = size_t(end - begin);
+            if (length >= sizeof(rule))
+            {
+                // Truncating would silently change what the rule matches
+                BadAccessGuardReport(false, "Bad access suppression rule too long (%d characters, max %d): %.64s...", int(length), int(sizeof(rule) - 1), begin);
+            }
+            else
+            {
+                memcpy(rule, begin, length);
+                rule[length] = '\0';
+                const AddSuppressionResult result = ParseSuppression(rule, length);
+                if (result == SuppressionAdd_Added) nbAdded++;
+                else if (result == SuppressionAdd_Invalid) BadAccessGuardReport(false, "Invalid (or too many) bad access suppression rule: %s", rule);
+            }
+        }
+        rules = *lineEnd ? lineEnd + 1 : lineEnd;
+    }
+    return nbAdded;
+}
+
+#if BA_GUARD_SUPPRESSIONS_FROM_ENV
+bool LoadSuppressionsFromEnvironment()
+{
+    // Not using _dupenv_s for MSVC, this is done once.
+    if (const char* rules = getenv("BAD_ACCESS_GUARDS_SUPPRESSIONS"))
+    {
+        BadAccessGuardAddSuppressions(rules);
+    }
+    if (const char* path = getenv("BAD_ACCESS_GUARDS_SUPPRESSIONS_FILE"))
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file)
+        {
+            BadAccessGuardReport(false, "Could not open bad access suppressions file %s", path);
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        const long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (char* content = size >= 0 ? (char*)malloc(size_t(size) + 1) : nullptr)
+        {
+            content[fread(content, 1, size_t(size), file)] = '\0';
+            BadAccessGuardAddSuppressions(content);
+            free(content);
+        }
+        fclose(file);
+    }
+    return true;
+}
+
+// Not done during static initialization: the environment and files may not be usable yet, and most programs never report anything.
+void LoadSuppressionsOnce()
+{
+    static const bool loaded = LoadSuppressionsFromEnvironment(); // Thread safe initialization
+    (void)loaded;
+}
+#endif
+
+// Returns true (and counts the hit) if the bad access must not be reported.
+bool IsSuppressed(const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace)
+{
+    SuppressionRule* rule = nullptr;
+    if (gNbSuppressionRules != 0)
+    {
+        if (!rule && site.file) { const char* fileName = FileNameWithoutDirectory(site.file); rule = FindSuppression(Suppression_Site, fileName, strlen(fileName), site.line); }
+        if (!rule && site.function) rule = FindSuppression(Suppression_Function, site.function, strlen(site.function), 0);
+        if (!rule && site.typeName) rule = FindSuppression(Suppression_Type, site.typeName, strlen(site.typeName), 0);
+    }
+    if (rule)
+    {
+        BA_GUARD_ATOMIC_INCREMENT_U64(rule->nbHits);
+        BA_GUARD_ATOMIC_INCREMENT_U64(gNbSuppressed);
+        return true;
+    }
+    for (int i = 0; i < gNbAddressSuppressionRules; i++)
+    {
+        AddressSuppressionRule& addressRule = gAddressSuppressionRules[i];
+        for (int frame = 0; frame < backtrace.count; frame++)
+        {
+            if (addressRule.begin <= uintptr_t(backtrace.frames[frame]) && uintptr_t(backtrace.frames[frame]) < addressRule.end)
+            {
+                BA_GUARD_ATOMIC_INCREMENT_U64(addressRule.nbHits);
+                BA_GUARD_ATOMIC_INCREMENT_U64(gNbSuppressed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint64_t BadAccessGuardGetSuppressedCount() { return gNbSuppressed; }
+
+void BadAccessGuardDumpSuppressions()
+{
+    BadAccessGuardReport(false, "Bad access suppressions: %d rule(s), %llu bad access(es) suppressed.", gNbSuppressionRules + gNbAddressSuppressionRules, (unsigned long long)gNbSuppressed);
+    for (int i = 0; i < gNbSuppressionRules; i++)
+    {
+        const SuppressionRule& rule = gSuppressionRules[i];
+        if (rule.kind == Suppression_Site) BadAccessGuardReport(false, "  %10llu site:%.*s:%d", (unsigned long long)rule.nbHits, int(rule.nameLength), rule.name, rule.line);
+        else BadAccessGuardReport(false, "  %10llu %s:%.*s", (unsigned long long)rule.nbHits, suppressionKindToStr[rule.kind], int(rule.nameLength), rule.name);
+    }
+    for (int i = 0; i < gNbAddressSuppressionRules; i++)
+    {
+        const AddressSuppressionRule& rule = gAddressSuppressionRules[i];
+        BadAccessGuardReport(false, "  %10llu addr:%llx-%llx", (unsigned long long)rule.nbHits, (unsigned long long)rule.begin, (unsigned long long)rule.end);
+    }
+}
+
+// Force inlined in all the BAGuardHandleBadAccess versions, so that skipping one frame makes the backtrace start at the guard (inlined in the guarded function).
+inline BA_GUARD_FORCE_INLINE void HandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site)
 {
+    const bool assertionOrWarning = site.assertionOrWarning;
+#if BAD_ACCESS_GUARDS_AMPLIFY
+    gAmplifyNbDetections.fetch_add(1, std::memory_order_relaxed);
+#endif
+
     // If you break here it means that we detected some bad memory access pattern
     // It could be that you are mutating a container recursively or a multi-threading race condition
     // You can now:
     // - Step/Continue to get information about the error (potentially waking offending threads if caused by a race condition)
     // - Inspect other threads callstacks (If using Visual Studio: Debug => Windows => Parallel Stacks)
     //   If the debugger broke and froze the other threads fast enough, you might be able to find the offending thread.
-    if (assertionOrWarning && gBadAccessGuardConfig.allowBreak && gBadAccessGuardConfig.breakASAP) BA_GUARD_DEBUGBREAK(); // Break asap in an attempt to catch the other thread in the act !
+    if (assertionOrWarning && gBadAccessGuardConfig.allowBreak && gBadAccessGuardConfig.breakASAP) BA_GUARD_DEBUGBREAK(); // Break asap, before the backtrace and suppressions, in an attempt to catch the other thread in the act !
+
+#if BA_GUARD_SUPPRESSIONS_FROM_ENV
+    LoadSuppressionsOnce();
+#endif
+    // Captured before the lookup since address suppression rules need it.
+    BadAccessGuardBacktrace backtrace;
+    backtrace.count = BA_GUARD_BACKTRACE_MAX_FRAMES > 0 ? BadAccessGuardCaptureBacktrace(backtrace.frames, BA_GUARD_BACKTRACE_MAX_FRAMES, 1) : 0; // Skip this function
+    if (IsSuppressed(site, backtrace)) return;
 
-    const bool breakAllowed = gBadAccessGuardConfig.reportBadAccess(previousOperation, toState, assertionOrWarning, message);
+    const bool breakAllowed = gBadAccessGuardConfig.reportBadAccess(previousOperation, toState, site, backtrace);
+#if BAD_ACCESS_GUARDS_WRITE_STACK
+    BadAccessGuardDumpWriteStack(assertionOrWarning);
+#endif
+#if BAD_ACCESS_GUARDS_FLIGHT_RECORDER
+    BadAccessGuardDumpFlightRecorder(assertionOrWarning);
+#endif
 
     if (assertionOrWarning && breakAllowed && gBadAccessGuardConfig.allowBreak && !gBadAccessGuardConfig.breakASAP)    BA_GUARD_DEBUGBREAK();
 }
 
+void BA_GUARD_SLOW_PATH BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site)
+{
+    HandleBadAccess(previousOperation, toState, site);
+}
+
+void BA_GUARD_SLOW_PATH BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message)
+{
+    const BadAccessGuardSite site{ nullptr, nullptr, nullptr, message, 0, assertionOrWarning };
+    HandleBadAccess(previousOperation, toState, site);
+}
+
+void BA_GUARD_SLOW_PATH BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState)
+{
+    const BadAccessGuardSite site{ nullptr, nullptr, nullptr, nullptr, 0, true };
+    HandleBadAccess(previousOperation, toState, site);
+}
+
+#if !defined(BA_GUARD_AUDIT_SIMD)
+# define BA_GUARD_AUDIT_SIMD 1 // Set to 0 to force the scalar version of BadAccessGuardAuditShadows
+#endif
+#if BA_GUARD_AUDIT_SIMD && UINTPTR_MAX > 0xFFFFFFFF
+# if defined(__AVX2__)
+#  include <immintrin.h>
+#  define BA_GUARD_AUDIT_AVX2 1
+# elif defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define BA_GUARD_AUDIT_SSE2 1
+# elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define BA_GUARD_AUDIT_NEON 1
+# endif
+#endif
+
+// Same test as reads: any bit of the state other than the frozen one means writing, destroyed or corrupted.
+const StateAndStackAddr AuditBadStateMask = BadAccessGuardShadow::WritingOrDestroyedMask;
+const size_t AuditBlockSize = 256; // Shadows ORed together before testing them, small enough to rescan from cache
+
+inline StateAndStackAddr AuditLoad(const char* base, size_t stride, size_t index)
+{
+    return *reinterpret_cast<const StateAndStackAddr*>(base + index * stride);
+}
+
+// OR of the shadows [begin, end).
+StateAndStackAddr AuditOrBlock(const char* base, size_t stride, size_t begin, size_t end)
+{
+    StateAndStackAddr acc = 0;
+    size_t i = begin;
+#if BA_GUARD_AUDIT_AVX2
+    if (stride == sizeof(StateAndStackAddr))
+    {
+        __m256i accVec = _mm256_setzero_si256();
+        for (; i + 8 <= end; i += 8)
+        {
+            const __m256i* const words = reinterpret_cast<const __m256i*>(base + i * stride);
+            accVec = _mm256_or_si256(accVec, _mm256_or_si256(_mm256_loadu_si256(words), _mm256_loadu_si256(words + 1)));
+        }
+        const __m128i acc128 = _mm_or_si128(_mm256_castsi256_si128(accVec), _mm256_extracti128_si256(accVec, 1));
+        acc |= StateAndStackAddr(_mm_cvtsi128_si64(acc128)) | StateAndStackAddr(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc128, acc128)));
+    }
+    else if (stride % sizeof(StateAndStackAddr) == 0 && stride <= size_t(INT32_MAX) / 4)
+    {
+        // No strided loads on x86, gathers are the next best thing
+        const long long s = (long long)stride;
+        const __m256i offsets = _mm256_set_epi64x(3 * s, 2 * s, s, 0);
+        __m256i accVec = _mm256_setzero_si256();
+        for (; i + 4 <= end; i += 4)
+        {
+            accVec = _mm256_or_si256(accVec, _mm256_i64gather_epi64(reinterpret_cast<const long long*>(base + i * stride), offsets, 1));
+        }
+        const __m128i acc128 = _mm_or_si128(_mm256_castsi256_si128(accVec), _mm256_extracti128_si256(accVec, 1));
+        acc |= StateAndStackAddr(_mm_cvtsi128_si64(acc128)) | StateAndStackAddr(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc128, acc128)));
+    }
+#elif BA_GUARD_AUDIT_SSE2
+    if (stride == sizeof(StateAndStackAddr))
+    {
+        __m128i accVec = _mm_setzero_si128();
+        for (; i + 4 <= end; i += 4)
+        {
+            const __m128i* const words = reinterpret_cast<const __m128i*>(base + i * stride);
+            accVec = _mm_or_si128(accVec, _mm_or_si128(_mm_loadu_si128(words), _mm_loadu_si128(words + 1)));
+        }
+        acc |= StateAndStackAddr(_mm_cvtsi128_si64(accVec)) | StateAndStackAddr(_mm_cvtsi128_si64(_mm_unpackhi_epi64(accVec, accVec)));
+    }
+#elif BA_GUARD_AUDIT_NEON
+    if (stride == sizeof(StateAndStackAddr))
+    {
+        uint64x2_t accVec = vdupq_n_u64(0);
+        for (; i + 4 <= end; i += 4)
+        {
+            const uint64_t* const words = reinterpret_cast<const uint64_t*>(base + i * stride);
+            accVec = vorrq_u64(accVec, vorrq_u64(vld1q_u64(words), vld1q_u64(words + 2)));
+        }
+        acc |= StateAndStackAddr(vgetq_lane_u64(accVec, 0) | vgetq_lane_u64(accVec, 1));
+    }
+#endif
+    // Scalar fallback and tail. Independent accumulators so that loads are not serialized.
+    StateAndStackAddr acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (; i + 4 <= end; i += 4)
+    {
+        acc0 |= AuditLoad(base, stride, i);
+        acc1 |= AuditLoad(base, stride, i + 1);
+        acc2 |= AuditLoad(base, stride, i + 2);
+        acc3 |= AuditLoad(base, stride, i + 3);
+    }
+    for (; i < end; i++) acc0 |= AuditLoad(base, stride, i);
+    return acc | acc0 | acc1 | acc2 | acc3;
+}
+
+size_t BadAccessGuardAuditShadows(const BadAccessGuardShadow* firstShadow, size_t stride, size_t count, size_t* outIndices, size_t maxIndices)
+{
+    const char* const base = reinterpret_cast<const char*>(firstShadow);
+    size_t nbOffending = 0;
+    for (size_t blockBegin = 0; blockBegin < count; blockBegin += AuditBlockSize)
+    {
+        const size_t blockEnd = count - blockBegin > AuditBlockSize ? blockBegin + AuditBlockSize : count;
+        if ((AuditOrBlock(base, stride, blockBegin, blockEnd) & AuditBadStateMask) == 0) continue; // Fast path, the whole block is fine
+
+        for (size_t i = blockBegin; i < blockEnd; i++)
+        {
+            if ((AuditLoad(base, stride, i) & AuditBadStateMask) == 0) continue;
+            if (nbOffending < maxIndices) outIndices[nbOffending] = i;
+            nbOffending++;
+        }
+    }
+    return nbOffending;
+}
+
+size_t BadAccessGuardReportAudit(const BadAccessGuardShadow* firstShadow, size_t stride, size_t count, size_t maxReported)
+{
+    size_t indices[64];
+    const size_t maxIndices = maxReported < sizeof(indices) / sizeof(indices[0]) ? maxReported : sizeof(indices) / sizeof(indices[0]);
+    const size_t nbOffending = BadAccessGuardAuditShadows(firstShadow, stride, count, indices, maxIndices);
+    if (nbOffending == 0) return 0;
+
+    BadAccessGuardReport(false, "Audit: %zu out of %zu shadow(s) are still writing, destroyed or corrupted.", nbOffending, count);
+    const char* const base = reinterpret_cast<const char*>(firstShadow);
+    for (size_t i = 0; i < nbOffending && i < maxIndices; i++)
+    {
+        const StateAndStackAddr value = AuditLoad(base, stride, indices[i]);
+        const BadAccessGuardState state = BadAccessGuardShadow::GetState(value);
+        const char* const stateStr = state == BAGuard_Writing ? "Writing" : state == BAGuard_DestructorCalled ? "Destroyed" : "Corrupted";
+        BadAccessGuardReport(false, "  [%zu] %s, stack address %p", indices[i], stateStr, BadAccessGuardShadow::GetInStackAddr(value));
+    }
+    if (nbOffending > maxIndices) BadAccessGuardReport(false, "  ... and %zu more.", nbOffending - maxIndices);
+    return nbOffending;
+}
+
 #include <stdio.h>
 #include <stdarg.h>
 bool BadAccessGuardReport(bool assertionOrWarning, const char* fmt, ...)
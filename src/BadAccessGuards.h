@@ -7,9 +7,11 @@
 // 4. For all (relevant) write operations of the container / object, use the scope guard `BA_GUARD_WRITE(varname)`. 
 //   Do this only if it always writes! For example, don't use it on `operator[]` even though it returns a reference, use `BA_GUARD_READ` instead.
 // 5. Add `BA_GUARD_DESTROY(varname)` at the beginning of the destructor.
+//   Objects that are built once and then only read may be frozen with `BA_GUARD_FREEZE(varname)`, any later write is then reported.
 // 6. Enjoy!
 //
 // You may optionally configure it with `BadAccessGuardSetConfig`.
+// Use `BA_GUARD_READ_SITE`/`BA_GUARD_WRITE_SITE` instead of the `_EX` versions to get the file, line, function and type name in reports.
 
 #if !defined(BAD_ACCESS_GUARDS_ENABLE)
 # if defined(NDEBUG)
@@ -30,21 +32,53 @@
 # define BAD_ACCESS_GUARDS_ENABLE 0
 #endif
 
+#if !defined(BAD_ACCESS_GUARDS_SCHEDULING_POINTS)
+# define BAD_ACCESS_GUARDS_SCHEDULING_POINTS 0
+#endif
+
+#if !defined(BAD_ACCESS_GUARDS_SDT_PROBES)
+# define BAD_ACCESS_GUARDS_SDT_PROBES 0 // Static probes for perf/bpftrace on Linux, see BA_GUARD_PROBE.
+#endif
+
+#if !defined(BAD_ACCESS_GUARDS_CENSUS)
+# define BAD_ACCESS_GUARDS_CENSUS 0 // Sample 1 out of N handoffs of objects between threads, 0 to disable. See BadAccessGuardDumpCensus.
+#endif
+
+#if !defined(BAD_ACCESS_GUARDS_FLIGHT_RECORDER)
+# define BAD_ACCESS_GUARDS_FLIGHT_RECORDER 0 // Number of guard operations recorded per thread (power of 2), 0 to disable. See BadAccessGuardFlightRing.
+#endif
+
+#if !defined(BAD_ACCESS_GUARDS_AMPLIFY)
+# define BAD_ACCESS_GUARDS_AMPLIFY 0 // Stress mode widening the write windows, see BadAccessGuardAmplifyConfig.
+#endif
+
+#if !defined(BAD_ACCESS_GUARDS_WRITE_STACK)
+# define BAD_ACCESS_GUARDS_WRITE_STACK 0 // Depth of the per-thread stack of active write guards, 0 to disable. See BadAccessGuardWriteStack.
+#endif
+
 #if BAD_ACCESS_GUARDS_ENABLE
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Why we use those macros:
 // - BA_GUARD_NO_INLINE: This is to limit performance impact on the fast path.
+// - BA_GUARD_SLOW_PATH: Only for BAGuardHandleBadAccess, the function called when a bad access is detected. It should be seen as cold and, when possible, not clobber the caller registers.
+//   Other out of line helpers (first use of a thread, sampling, deep stacks) may run in normal executions and use BA_GUARD_NO_INLINE.
 // - BA_GUARD_GET_PTR_IN_STACK: No other portable way to do it. This must return a pointer to the current stack. Expected to be faster than getting the thread Id (and works with fibers).
+// - BA_GUARD_RETURN_ADDRESS: Only used by the flight recorder, to know which function called the guarded operation.
+// - BA_GUARD_THREAD_LOCAL: For thread local variables used by guards. Plain TLS on GCC/clang, an `extern thread_local` would go through a wrapper function in case it is dynamically initialized.
 // - BA_GUARD_FORCE_INLINE: We want to reduce the overhead in debug builds as much as possible.
 // - BA_GUARD_ATOMIC_RELAXED_LOAD/STORE_UPTR: We really don't want to use std::atomic for debug build performance.
 //  On top of this, this avoids including std headers for project that may restrict its usage.
 #if defined(_MSC_VER) // MSVC
 # include <intrin.h> // Necessary for _AddressOfReturnAddress
 # define BA_GUARD_NO_INLINE __declspec(noinline)
+# define BA_GUARD_SLOW_PATH __declspec(noinline)
 # define BA_GUARD_FORCE_INLINE __forceinline // Need to use /d2Obforceinline for MSVC 17.7+ debug builds, otherwise it doesnt work! Not compatible with /Od...
 # define BA_GUARD_GET_PTR_IN_STACK() _AddressOfReturnAddress()
+# define BA_GUARD_RETURN_ADDRESS() _ReturnAddress()
+# define BA_GUARD_THREAD_LOCAL thread_local
 # ifdef _WIN64 // 64 bits
 #  define BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(var) static_cast<uintptr_t>(__iso_volatile_load64(reinterpret_cast<volatile int64_t*>(&var)))
 #  define BA_GUARD_ATOMIC_RELAXED_STORE_UPTR(var, value) __iso_volatile_store64(reinterpret_cast<volatile int64_t*>(&var), value)
@@ -56,7 +90,18 @@
 #elif defined(__GNUC__) || defined(__GNUG__) // GCC / clang
 # define BA_GUARD_FORCE_INLINE __attribute__((always_inline))
 # define BA_GUARD_NO_INLINE __attribute__ ((noinline))
+# if defined(__clang__) && (defined(__x86_64__) || defined(__aarch64__))
+// With the default calling convention, the compiler must assume that the slow path clobbers all caller-saved registers.
+// Even though it is never called, this makes the inlined guards spill/reload registers in hot loops.
+// preserve_most moves the burden of saving (general purpose) registers to the slow path itself.
+#  define BA_GUARD_SLOW_PATH __attribute__ ((noinline, cold, preserve_most))
+# else
+// GCC has no equivalent: no_caller_saved_registers does not preserve SSE registers, which the slow path (and printf...) uses.
+#  define BA_GUARD_SLOW_PATH __attribute__ ((noinline, cold))
+# endif
 # define BA_GUARD_GET_PTR_IN_STACK() __builtin_frame_address(0)
+# define BA_GUARD_RETURN_ADDRESS() __builtin_return_address(0)
+# define BA_GUARD_THREAD_LOCAL __thread
 # define BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(var) __atomic_load_n(&var, __ATOMIC_RELAXED);
 # define BA_GUARD_ATOMIC_RELAXED_STORE_UPTR(var, value) __atomic_store_n(&var, value, __ATOMIC_RELAXED);
 # if defined(__clang__)
@@ -87,11 +132,13 @@
 #endif
 
 
+// Values are chosen so that reads (and destruction) only need a single test: the frozen bit is the only state bit they may see set.
 enum BadAccessGuardState : uintptr_t
 {
     BAGuard_ReadingOrIdle = 0,
     BAGuard_Writing = 1,
-    BAGuard_DestructorCalled = 2,
+    BAGuard_Frozen = 2, // Only read from now on, see `BA_GUARD_FREEZE`.
+    BAGuard_DestructorCalled = 3,
     BAGuard_StatesCount
 };
 
@@ -112,6 +159,9 @@ struct BadAccessGuardShadow
 
     static constexpr StateAndStackAddr BadAccessStateMask = (1 << BadAccessStateBits) - 1;
     static constexpr StateAndStackAddr InStackAddrMask = StateAndStackAddr(-1) ^ BadAccessStateMask;
+    // Every state bit but the frozen one: a single test for writing, destroyed, and (on Windows where the state is a byte) corrupted values.
+    static constexpr StateAndStackAddr WritingOrDestroyedMask = BadAccessStateMask & ~StateAndStackAddr(BAGuard_Frozen);
+    static_assert((BAGuard_Writing & WritingOrDestroyedMask) && (BAGuard_DestructorCalled & WritingOrDestroyedMask) && !(BAGuard_Frozen & WritingOrDestroyedMask), "Reads must be able to test a single mask");
 
     StateAndStackAddr stateAndInStackAddr{ BAGuard_ReadingOrIdle };
 
@@ -122,104 +172,539 @@ struct BadAccessGuardShadow
     }
     // Those are static because we want to work on copies of the data and not pay for the atomic access
     static BA_GUARD_FORCE_INLINE BadAccessGuardState GetState(StateAndStackAddr packedValue) { return BadAccessGuardState(packedValue & BadAccessStateMask); }
+    // What reads and destruction check: not an issue if the object is idle, being read, or frozen. Corrupted values are caught too on Windows.
+    static BA_GUARD_FORCE_INLINE bool IsWritingOrDestroyed(StateAndStackAddr packedValue) { return (packedValue & WritingOrDestroyedMask) != 0; }
     static BA_GUARD_FORCE_INLINE void* GetInStackAddr(StateAndStackAddr packedValue) { return (void*)StateAndStackAddr(packedValue & InStackAddrMask); }
+    // Shadows storing something else than a stack address (see BadAccessGuardTaggedPtr) set this to false, and convert their value to this layout before reporting it.
+    static constexpr bool HasInStackAddr = true;
+    static BA_GUARD_FORCE_INLINE StateAndStackAddr ToReportedOperation(StateAndStackAddr packedValue) { return packedValue; }
 };
 
-// We have two versions to reduce code size at call site
-void BA_GUARD_NO_INLINE BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message);
-// Both inline and no_inline! inline is necessary because we define it in a header, but still we don't actually want to inline it, hence no-inline.
-inline void BA_GUARD_NO_INLINE BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState) { BAGuardHandleBadAccess(previousOperation, toState, true, nullptr); }
+#if UINTPTR_MAX > 0xFFFFFFFF
+// Shadow for objects living in memory shared between processes (`shm_open`/`mmap`, `CreateFileMapping`...). 64 bits only.
+// A stack address means nothing to another process, so we also pack a tag of the process in the upper bits, which are unused by userspace addresses.
+// Reports can then tell apart races with another thread of this process and races with another process.
+// The tag is derived from the process id, two processes may share the same tag (1 chance in 65535) and be reported as the same process.
+// Regular shadows have a tag of 0. Declare with `BA_GUARD_SHARED_DECL`, other macros work on both kinds of shadows.
+// Tag of the current process, already shifted. Updated in the child process after `fork`.
+extern StateAndStackAddr gBadAccessGuardProcessTag;
+struct BadAccessGuardSharedShadow : BadAccessGuardShadow
+{
+    static constexpr int ProcessTagShift = 48;
+    static constexpr StateAndStackAddr ProcessTagMask = StateAndStackAddr(0xFFFF) << ProcessTagShift;
 
-struct BadAccessGuardRead
+    BA_GUARD_FORCE_INLINE void SetStateAtomicRelaxed(BadAccessGuardState newState)
+    {
+        BA_GUARD_ATOMIC_RELAXED_STORE_UPTR(stateAndInStackAddr, (StateAndStackAddr(BA_GUARD_GET_PTR_IN_STACK()) & InStackAddrMask & ~ProcessTagMask) | gBadAccessGuardProcessTag | StateAndStackAddr(newState));
+    }
+    static BA_GUARD_FORCE_INLINE uint32_t GetProcessTag(StateAndStackAddr packedValue) { return uint32_t(packedValue >> ProcessTagShift); }
+    static BA_GUARD_FORCE_INLINE void* GetInStackAddr(StateAndStackAddr packedValue) { return (void*)StateAndStackAddr(packedValue & InStackAddrMask & ~ProcessTagMask); }
+};
+#endif
+
+template<typename T> struct BadAccessGuardShadowType { using type = T; };
+template<typename T> struct BadAccessGuardShadowType<T&> { using type = T; };
+
+#if !defined(BA_GUARD_BACKTRACE_MAX_FRAMES)
+# define BA_GUARD_BACKTRACE_MAX_FRAMES 32 // Set to 0 to disable backtrace capture in the slow path
+#endif
+
+// Callstack of the thread that detected the bad access, innermost frame first.
+// Captured in the slow path only, without allocating.
+struct BadAccessGuardBacktrace
+{
+    void* frames[BA_GUARD_BACKTRACE_MAX_FRAMES > 0 ? BA_GUARD_BACKTRACE_MAX_FRAMES : 1];
+    int count;
+};
+
+// Fills `outFrames` with the return addresses of the calling thread, skipping the `skipFrames` innermost ones. Returns the number of frames captured.
+// On GCC/clang this walks the frame pointers, so it stops at the first function compiled without them (see `-fno-omit-frame-pointer`).
+int BadAccessGuardCaptureBacktrace(void** outFrames, int maxFrames, int skipFrames);
+
+// Static description of a guarded call site, emitted as a `static constexpr` by `BA_GUARD_READ_SITE`/`BA_GUARD_WRITE_SITE`.
+// Guards only know its address at compile time and pass it on the slow path, so it costs nothing on the fast path.
+// Since each site has a unique address, it can be used as a key to filter or deduplicate reports.
+struct BadAccessGuardSite
+{
+    const char* file;
+    const char* function;
+    const char* typeName; // Type of the guarded object. May be null.
+    const char* message;  // If non-null, replaces the default message. May be null.
+    int line;
+    bool assertionOrWarning;
+};
+
+// Test mode only: with `BAD_ACCESS_GUARDS_SCHEDULING_POINTS=1`, guards call the hook when entering a read, and while holding the write state.
+// This lets a test scheduler preempt the current thread right where races can be detected. See BadAccessGuardsExplorer.h.
+#if BAD_ACCESS_GUARDS_SCHEDULING_POINTS
+void BadAccessGuardSchedulingPoint(const BadAccessGuardShadow& shadow);
+# define BA_GUARD_SCHEDULING_POINT(SHADOW) BadAccessGuardSchedulingPoint(SHADOW)
+#else
+# define BA_GUARD_SCHEDULING_POINT(SHADOW) do {} while(false)
+#endif
+using BadAccessGuardSchedulingPointHook = void(const BadAccessGuardShadow& shadow);
+void BadAccessGuardSetSchedulingPointHook(BadAccessGuardSchedulingPointHook* hook);
+
+// Opt-in: with `BAD_ACCESS_GUARDS_SDT_PROBES=1`, guards contain USDT probes (provider `bad_access_guards`) that can be attached to without rebuilding:
+// - `guard_enter`: read, write and destroy guards, after loading the shadow.
+// - `guard_exit`: write guards destructors, after loading the shadow.
+// - `bad_access`: on detection, before calling the slow path.
+// Arguments are the shadow address, the state the guard transitions to, and the packed value loaded from the shadow.
+// A probe is a single `nop` plus an ELF note, the same as `sys/sdt.h` would emit, so that you do not need the systemtap headers. Linux x64 and AArch64 only.
+// Example: `bpftrace -e 'usdt:./app:bad_access_guards:bad_access { printf("%p %d %p\n", arg0, arg1, arg2); }'`
+#if BAD_ACCESS_GUARDS_SDT_PROBES
+# if !defined(__ELF__) || !(defined(__x86_64__) || defined(__aarch64__)) || !(defined(__GNUC__) || defined(__clang__))
+#  error "BAD_ACCESS_GUARDS_SDT_PROBES is only implemented for ELF x64/AArch64 targets with GCC/clang"
+# endif
+// Same layout as sys/sdt.h: the note holds the probe address, the address of `_.stapsdt.base` (to handle prelinking), no semaphore, then provider, name and arguments.
+# define BA_GUARD_PROBE(NAME, SHADOW, STATE, PACKED) \
+    __asm__ __volatile__( \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: .8byte 990b\n" \
+        ".8byte _.stapsdt.base\n" \
+        ".8byte 0\n" \
+        ".asciz \"bad_access_guards\"\n" \
+        ".asciz \"" #NAME "\"\n" \
+        ".asciz \"8@%0 8@%1 8@%2\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n" \
+        :: "nor"(uintptr_t(&(SHADOW))), "nor"(uintptr_t(STATE)), "nor"(uintptr_t(PACKED)))
+#else
+# define BA_GUARD_PROBE(NAME, SHADOW, STATE, PACKED) do {} while(false)
+#endif
+
+// Opt-in: with `BAD_ACCESS_GUARDS_FLIGHT_RECORDER=K`, each thread records its last K guard operations in a ring buffer.
+// When a bad access is detected, the rings of all threads are merged by timestamp and dumped after the report, to show the history that led there.
+// Recording is a few fixed-size stores to thread local memory, no atomics nor branches other than the first use by a thread.
+// It must have the same value for all the code using guards and BadAccessGuards.cpp.
+enum BadAccessGuardFlightOp : uintptr_t
+{
+    BAGuardOp_Read,
+    BAGuardOp_WriteBegin,
+    BAGuardOp_WriteEnd,
+    BAGuardOp_Destroy,
+    BAGuardOp_Freeze,
+};
+
+struct BadAccessGuardFlightEntry
+{
+    uint64_t timestamp; // TSC (x86) or virtual counter (AArch64), assumed to be synchronized across cores
+    const BadAccessGuardShadow* shadow;
+    void* returnAddress; // Return address of the function containing the guard
+    BadAccessGuardFlightOp operation; // Pointer sized, so that entries have no padding
+};
+
+// Dumps the merged rings with `BadAccessGuardReport`. Called by the slow path, but you may call it yourself. Does nothing if the flight recorder is disabled.
+void BadAccessGuardDumpFlightRecorder(bool assertionOrWarning);
+
+#if BAD_ACCESS_GUARDS_FLIGHT_RECORDER
+static_assert((BAD_ACCESS_GUARDS_FLIGHT_RECORDER & (BAD_ACCESS_GUARDS_FLIGHT_RECORDER - 1)) == 0, "BAD_ACCESS_GUARDS_FLIGHT_RECORDER must be a power of 2");
+
+struct BadAccessGuardFlightRing
+{
+    uint64_t nbRecorded; // The next entry goes to entries[nbRecorded % K]
+    BadAccessGuardFlightEntry entries[BAD_ACCESS_GUARDS_FLIGHT_RECORDER];
+};
+
+# if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#  define BA_GUARD_TIMESTAMP() __rdtsc()
+# elif defined(_MSC_VER) && defined(_M_ARM64)
+#  define BA_GUARD_TIMESTAMP() uint64_t(_ReadStatusReg(ARM64_CNTVCT))
+# elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#  define BA_GUARD_TIMESTAMP() __builtin_ia32_rdtsc()
+# elif defined(__GNUC__) && defined(__aarch64__)
+inline BA_GUARD_FORCE_INLINE uint64_t BadAccessGuardReadVirtualCounter() { uint64_t value; __asm__ volatile("mrs %0, cntvct_el0" : "=r"(value)); return value; }
+#  define BA_GUARD_TIMESTAMP() BadAccessGuardReadVirtualCounter()
+# else
+// No cheap timestamp, fallback to a global counter. Much slower, but keeps the merged history in order.
+uint64_t BadAccessGuardFlightClock();
+#  define BA_GUARD_TIMESTAMP() BadAccessGuardFlightClock()
+# endif
+
+extern BA_GUARD_THREAD_LOCAL BadAccessGuardFlightRing* tBadAccessGuardFlightRing;
+// Registers a ring for the current thread, on its first guarded operation.
+BadAccessGuardFlightRing* BA_GUARD_NO_INLINE BadAccessGuardAcquireFlightRing();
+
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardRecord(const BadAccessGuardShadow& shadow, BadAccessGuardFlightOp operation, void* returnAddress)
+{
+    BadAccessGuardFlightRing* ring = tBadAccessGuardFlightRing;
+    if (!ring) BA_GUARD_UNLIKELY
+    {
+        ring = BadAccessGuardAcquireFlightRing();
+    }
+    BadAccessGuardFlightEntry& entry = ring->entries[ring->nbRecorded++ & (BAD_ACCESS_GUARDS_FLIGHT_RECORDER - 1)];
+    entry.timestamp = BA_GUARD_TIMESTAMP();
+    entry.shadow = &shadow;
+    entry.returnAddress = returnAddress;
+    entry.operation = operation;
+}
+// A macro so that the return address is the one of the function using the guard, guards being force inlined.
+# define BA_GUARD_RECORD(SHADOW, OPERATION) BadAccessGuardRecord(SHADOW, OPERATION, BA_GUARD_RETURN_ADDRESS())
+#else
+# define BA_GUARD_RECORD(SHADOW, OPERATION) do {} while(false)
+#endif
+
+// Opt-in: with `BAD_ACCESS_GUARDS_CENSUS=N`, write guards check whether the previous operation on the shadow came from another thread,
+// using the stack address it already stores, and sample 1 out of N of those handoffs in a side table.
+// Use it to find which objects actually cross threads before adding locks or moving to lock-free designs.
+// Only writes store their stack address, so reads from other threads are not seen. Must have the same value for all the code using guards and BadAccessGuards.cpp.
+struct BadAccessGuardCensusEntry
+{
+    const BadAccessGuardShadow* shadow;
+    void* firstReturnAddress; // Return address of the function containing the guard, for the first sampled handoff
+    uint64_t nbHandoffs; // Estimate: number of sampled handoffs times N
+};
+
+// Fills `outEntries` with up to `maxEntries` objects, most handed off first. Returns the number of entries written.
+int BadAccessGuardGetCensus(BadAccessGuardCensusEntry* outEntries, int maxEntries);
+// Prints the `maxEntries` most handed off objects with `BadAccessGuardReport`.
+void BadAccessGuardDumpCensus(int maxEntries);
+void BadAccessGuardResetCensus();
+
+#if BAD_ACCESS_GUARDS_CENSUS
+// Stack of the current thread, `StackSize` is 0 until the first handoff check of the thread.
+extern BA_GUARD_THREAD_LOCAL uintptr_t tBadAccessGuardCensusStackLow;
+extern BA_GUARD_THREAD_LOCAL uintptr_t tBadAccessGuardCensusStackSize;
+void BA_GUARD_NO_INLINE BadAccessGuardCensusHandoff(const BadAccessGuardShadow& shadow, uintptr_t previousInStackAddr, void* returnAddress);
+
+// Out of the current stack (or bounds not initialized yet) means another thread. Single unsigned comparison for both bounds.
+// Skipped at compile time for shadows without a stack address.
+# define BA_GUARD_CENSUS(SHADOW, PREVIOUS_IN_STACK_ADDR) \
+    do { \
+        if (BadAccessGuardShadowType<decltype(SHADOW)>::type::HasInStackAddr && uintptr_t(PREVIOUS_IN_STACK_ADDR) - tBadAccessGuardCensusStackLow >= tBadAccessGuardCensusStackSize) BA_GUARD_UNLIKELY \
+        { \
+            BadAccessGuardCensusHandoff(SHADOW, uintptr_t(PREVIOUS_IN_STACK_ADDR), BA_GUARD_RETURN_ADDRESS()); \
+        } \
+    } while (false)
+#else
+# define BA_GUARD_CENSUS(SHADOW, PREVIOUS_IN_STACK_ADDR) do {} while(false)
+#endif
+
+// Stress mode: with `BAD_ACCESS_GUARDS_AMPLIFY=1`, write guards wait a bit before their destructor clears the writing state.
+// Detection depends on how long shadows stay in `BAGuard_Writing`, and short writes almost never overlap. This widens the window, at the cost of slowing down the program.
+// - The delay is random, up to `maxDelayNs`, and scaled per site (the function containing the guard, hashed: a few sites may share a scale).
+// - Sites whose window saw no conflict progressively back off down to 1/64th of the delay, and go back to the full delay as soon as one is seen.
+// - Each thread stops waiting while the time it spent waiting is above `budget` times its running time (since its first guarded write).
+//   It then only looks at 1 out of N writes, N doubling while over budget. The budget does not include the cost of calling `BadAccessGuardAmplify` on each write.
+// Must have the same value for all the code using guards and BadAccessGuards.cpp.
+enum BadAccessGuardAmplifyMode : uint8_t
+{
+    BAGuardAmplify_Off,
+    BAGuardAmplify_Spin,  // Busy wait, best for multi-core machines
+    BAGuardAmplify_Yield, // Yield until the delay is over, lets other threads of the same core run in the window
+    BAGuardAmplify_Sleep, // Sleep, delays are rounded up by the OS (often to tens of microseconds)
+};
+
+struct BadAccessGuardAmplifyConfig
+{
+    BadAccessGuardAmplifyMode mode; // Default: BAGuardAmplify_Spin
+    uint32_t maxDelayNs;            // Default: 2000
+    float budget;                   // Default: 0.25, the program runs at most ~25% slower because of the delays.
+};
+
+// Check BAD_ACCESS_GUARDS_AMPLIFY if you want to use those. Not thread safe: configure before guards are used.
+BadAccessGuardAmplifyConfig BadAccessGuardGetAmplifyConfig();
+void BadAccessGuardSetAmplifyConfig(BadAccessGuardAmplifyConfig config);
+
+#if BAD_ACCESS_GUARDS_AMPLIFY
+void BA_GUARD_NO_INLINE BadAccessGuardAmplify(const BadAccessGuardShadow& shadow, void* returnAddress);
+# define BA_GUARD_AMPLIFY(SHADOW) BadAccessGuardAmplify(SHADOW, BA_GUARD_RETURN_ADDRESS())
+#else
+# define BA_GUARD_AMPLIFY(SHADOW) do {} while(false)
+#endif
+
+// Opt-in: with `BAD_ACCESS_GUARDS_WRITE_STACK=D`, each thread keeps a stack of its active write guards (shadow, and return address of the function containing the guard), up to D deep.
+// - Reports then list the writes the current thread is nested in, outermost first, to show which object or call started a recursion.
+// - A write guard skipped by `longjmp` leaves its shadow writing forever. It is reported when an outer write guard ends, or when the thread exits.
+// Pushing and popping are a few stores to thread local memory and a single compare. Guards deeper than D are counted but not stored nor checked.
+// Fibers switching on the same thread share its stack, so a write guard held across a switch is reported too. Must have the same value for all the code using guards and BadAccessGuards.cpp.
+struct BadAccessGuardWriteStackEntry
+{
+    const void* shadow;
+    void* returnAddress; // Return address of the function containing the guard
+};
+
+// Prints the active write guards of the current thread with `BadAccessGuardReport`. Called by the slow path, but you may call it yourself. Does nothing if the stack is disabled.
+void BadAccessGuardDumpWriteStack(bool assertionOrWarning);
+
+#if BAD_ACCESS_GUARDS_WRITE_STACK
+struct BadAccessGuardWriteStack
+{
+    uint32_t depth;    // Number of active write guards, may be above `capacity`
+    uint32_t capacity; // 0 until the first push of the thread, so that the same compare registers the check at thread exit
+    BadAccessGuardWriteStackEntry entries[BAD_ACCESS_GUARDS_WRITE_STACK];
+};
+
+extern BA_GUARD_THREAD_LOCAL BadAccessGuardWriteStack tBadAccessGuardWriteStack;
+void BA_GUARD_NO_INLINE BadAccessGuardWriteStackPushSlow(const void* shadow, void* returnAddress);
+// Top of the stack is not `shadow`: guards above it were skipped, or the stack is deeper than D.
+void BA_GUARD_NO_INLINE BadAccessGuardWriteStackPopSlow(const void* shadow);
+
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardWriteStackPush(const void* shadow, void* returnAddress)
+{
+    BadAccessGuardWriteStack& stack = tBadAccessGuardWriteStack;
+    if (stack.depth >= stack.capacity) BA_GUARD_UNLIKELY
+    {
+        BadAccessGuardWriteStackPushSlow(shadow, returnAddress);
+        return;
+    }
+    stack.entries[stack.depth] = { shadow, returnAddress };
+    stack.depth++;
+}
+
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardWriteStackPop(const void* shadow)
+{
+    BadAccessGuardWriteStack& stack = tBadAccessGuardWriteStack;
+    const uint32_t top = stack.depth - 1; // Wraps if empty
+    if (top >= BAD_ACCESS_GUARDS_WRITE_STACK || stack.entries[top].shadow != shadow) BA_GUARD_UNLIKELY
+    {
+        BadAccessGuardWriteStackPopSlow(shadow);
+        return;
+    }
+    stack.depth = top;
+}
+// Macros so that the return address is the one of the function using the guard, guards being force inlined.
+# define BA_GUARD_STACK_PUSH(SHADOW) BadAccessGuardWriteStackPush(&(SHADOW), BA_GUARD_RETURN_ADDRESS())
+# define BA_GUARD_STACK_POP(SHADOW) BadAccessGuardWriteStackPop(&(SHADOW))
+#else
+# define BA_GUARD_STACK_PUSH(SHADOW) do {} while(false)
+# define BA_GUARD_STACK_POP(SHADOW) do {} while(false)
+#endif
+
+// We have multiple versions to reduce code size at call site
+void BA_GUARD_SLOW_PATH BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site);
+void BA_GUARD_SLOW_PATH BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message);
+// Defined in the .cpp and not as an inline wrapper of the previous one, otherwise the wrapper would be the first frame of the backtrace when its call is not a tail call (-O0/-O1).
+void BA_GUARD_SLOW_PATH BAGuardHandleBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState);
+
+template<typename ShadowT>
+struct BadAccessGuardReadT
 {
     // We have two versions of the constructor purely for performance
-    BA_GUARD_FORCE_INLINE BadAccessGuardRead(BadAccessGuardShadow& shadow)
+    BA_GUARD_FORCE_INLINE BadAccessGuardReadT(ShadowT& shadow)
     {
+        BA_GUARD_RECORD(shadow, BAGuardOp_Read);
+        BA_GUARD_SCHEDULING_POINT(shadow);
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY // Early out on fast path
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (ShadowT::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY // Early out on fast path
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_ReadingOrIdle);
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_ReadingOrIdle);
         }
     }
-    BA_GUARD_FORCE_INLINE BadAccessGuardRead(BadAccessGuardShadow& shadow, bool assertionOrWarning, char* message)
+    BA_GUARD_FORCE_INLINE BadAccessGuardReadT(ShadowT& shadow, bool assertionOrWarning, char* message)
     {
+        BA_GUARD_RECORD(shadow, BAGuardOp_Read);
+        BA_GUARD_SCHEDULING_POINT(shadow);
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY// Early out on fast path
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (ShadowT::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY // Early out on fast path
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_ReadingOrIdle, assertionOrWarning, message);
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_ReadingOrIdle, assertionOrWarning, message);
         }
     }
     // We do not check again after the read itself, it would add too much cost for little benefit. Most of the issues will be caught by the write ops.
 };
 
-struct BadAccessGuardWrite
+template<typename ShadowT>
+struct BadAccessGuardWriteT
 {
-    BadAccessGuardShadow& shadow;
-    BA_GUARD_FORCE_INLINE BadAccessGuardWrite(BadAccessGuardShadow& shadow)
+    ShadowT& shadow;
+    BA_GUARD_FORCE_INLINE BadAccessGuardWriteT(ShadowT& shadow)
         : shadow(shadow)
     {
+        BA_GUARD_RECORD(shadow, BAGuardOp_WriteBegin);
+        BA_GUARD_STACK_PUSH(shadow); // First, so that reports of this guard show it on top
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_Writing, lastSeenOp);
+        if (ShadowT::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing);
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing);
+            if (ShadowT::GetState(lastSeenOp) == BAGuard_Frozen) return; // Stays frozen, so that later writes are reported too
         }
+        BA_GUARD_CENSUS(shadow, ShadowT::GetInStackAddr(lastSeenOp));
         shadow.SetStateAtomicRelaxed(BAGuard_Writing); // Always write, so that we may trigger in the other thread too
+        BA_GUARD_SCHEDULING_POINT(shadow); // Let other threads run while we are writing
     }
-    BA_GUARD_FORCE_INLINE ~BadAccessGuardWrite()
+    BA_GUARD_FORCE_INLINE ~BadAccessGuardWriteT()
     {
+        BA_GUARD_AMPLIFY(shadow); // Still in the writing state, the other thread may notice
+        BA_GUARD_RECORD(shadow, BAGuardOp_WriteEnd);
+        BA_GUARD_STACK_POP(shadow); // Before any early return
+        BA_GUARD_SCHEDULING_POINT(shadow);
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_Writing) BA_GUARD_UNLIKELY
+        BA_GUARD_PROBE(guard_exit, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (ShadowT::GetState(lastSeenOp) != BAGuard_Writing) BA_GUARD_UNLIKELY
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing);
+            if (ShadowT::GetState(lastSeenOp) == BAGuard_Frozen) return; // Already reported by the constructor (or by BA_GUARD_FREEZE)
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing);
         }
         shadow.SetStateAtomicRelaxed(BAGuard_ReadingOrIdle);
     }
 };
 
-// Same as BadAccessGuardWrite, but with additional options
-struct BadAccessGuardWriteEx
+// Same as BadAccessGuardWriteT, but with additional options
+template<typename ShadowT>
+struct BadAccessGuardWriteExT
 {
-    BadAccessGuardShadow& shadow;
+    ShadowT& shadow;
     const char* const message;
     const bool assertionOrWarning;
-    BA_GUARD_FORCE_INLINE BadAccessGuardWriteEx(BadAccessGuardShadow& d, bool assertionOrWarning = false, char* message = nullptr)
+    BA_GUARD_FORCE_INLINE BadAccessGuardWriteExT(ShadowT& d, bool assertionOrWarning = false, char* message = nullptr)
         : shadow(d)
         , message(message)
         , assertionOrWarning(assertionOrWarning)
     {
+        BA_GUARD_RECORD(shadow, BAGuardOp_WriteBegin);
+        BA_GUARD_STACK_PUSH(shadow); // First, so that reports of this guard show it on top
+        const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_Writing, lastSeenOp);
+        if (ShadowT::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
+        {
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing, assertionOrWarning, message);
+            if (ShadowT::GetState(lastSeenOp) == BAGuard_Frozen) return; // Stays frozen, so that later writes are reported too
+        }
+        BA_GUARD_CENSUS(shadow, ShadowT::GetInStackAddr(lastSeenOp));
+        shadow.SetStateAtomicRelaxed(BAGuard_Writing); // Always write, may trigger on other thread too
+        BA_GUARD_SCHEDULING_POINT(shadow); // Let other threads run while we are writing
+    }
+    BA_GUARD_FORCE_INLINE ~BadAccessGuardWriteExT()
+    {
+        BA_GUARD_AMPLIFY(shadow); // Still in the writing state, the other thread may notice
+        BA_GUARD_RECORD(shadow, BAGuardOp_WriteEnd);
+        BA_GUARD_STACK_POP(shadow); // Before any early return
+        BA_GUARD_SCHEDULING_POINT(shadow);
+        const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
+        BA_GUARD_PROBE(guard_exit, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (ShadowT::GetState(lastSeenOp) != BAGuard_Writing) BA_GUARD_UNLIKELY
+        {
+            if (ShadowT::GetState(lastSeenOp) == BAGuard_Frozen) return; // Already reported by the constructor (or by BA_GUARD_FREEZE)
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing, assertionOrWarning, message);
+        }
+        shadow.SetStateAtomicRelaxed(BAGuard_ReadingOrIdle);
+    }
+};
+
+// Same as BadAccessGuardReadT, but reports using the static site descriptor `SiteT::Get()`. See `BA_GUARD_READ_SITE`.
+template<typename SiteT, typename ShadowT = BadAccessGuardShadow>
+struct BadAccessGuardReadSite
+{
+    BA_GUARD_FORCE_INLINE BadAccessGuardReadSite(ShadowT& shadow)
+    {
+        BA_GUARD_RECORD(shadow, BAGuardOp_Read);
+        BA_GUARD_SCHEDULING_POINT(shadow);
+        const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (ShadowT::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY
+        {
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_ReadingOrIdle, *SiteT::Get());
+        }
+    }
+};
+
+// Same as BadAccessGuardWriteEx, but the options live in the static site descriptor `SiteT::Get()` instead of the guard. See `BA_GUARD_WRITE_SITE`.
+template<typename SiteT, typename ShadowT = BadAccessGuardShadow>
+struct BadAccessGuardWriteSite
+{
+    ShadowT& shadow;
+    BA_GUARD_FORCE_INLINE BadAccessGuardWriteSite(ShadowT& shadow)
+        : shadow(shadow)
+    {
+        BA_GUARD_RECORD(shadow, BAGuardOp_WriteBegin);
+        BA_GUARD_STACK_PUSH(shadow); // First, so that reports of this guard show it on top
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_Writing, lastSeenOp);
+        if (ShadowT::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing, assertionOrWarning, message);
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing, *SiteT::Get());
+            if (ShadowT::GetState(lastSeenOp) == BAGuard_Frozen) return; // Stays frozen, so that later writes are reported too
         }
+        BA_GUARD_CENSUS(shadow, ShadowT::GetInStackAddr(lastSeenOp));
         shadow.SetStateAtomicRelaxed(BAGuard_Writing); // Always write, may trigger on other thread too
+        BA_GUARD_SCHEDULING_POINT(shadow); // Let other threads run while we are writing
     }
-    BA_GUARD_FORCE_INLINE ~BadAccessGuardWriteEx()
+    BA_GUARD_FORCE_INLINE ~BadAccessGuardWriteSite()
     {
+        BA_GUARD_AMPLIFY(shadow); // Still in the writing state, the other thread may notice
+        BA_GUARD_RECORD(shadow, BAGuardOp_WriteEnd);
+        BA_GUARD_STACK_POP(shadow); // Before any early return
+        BA_GUARD_SCHEDULING_POINT(shadow);
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_Writing) BA_GUARD_UNLIKELY
+        BA_GUARD_PROBE(guard_exit, shadow, BAGuard_ReadingOrIdle, lastSeenOp);
+        if (ShadowT::GetState(lastSeenOp) != BAGuard_Writing) BA_GUARD_UNLIKELY
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing, assertionOrWarning, message);
+            if (ShadowT::GetState(lastSeenOp) == BAGuard_Frozen) return; // Already reported by the constructor (or by BA_GUARD_FREEZE)
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing, *SiteT::Get());
         }
         shadow.SetStateAtomicRelaxed(BAGuard_ReadingOrIdle);
     }
 };
 
-struct BadAccessGuardDestroy
+template<typename ShadowT>
+struct BadAccessGuardDestroyT
 {
-    BadAccessGuardShadow& shadow;
-    BA_GUARD_FORCE_INLINE BadAccessGuardDestroy(BadAccessGuardShadow& shadow)
+    ShadowT& shadow;
+    BA_GUARD_FORCE_INLINE BadAccessGuardDestroyT(ShadowT& shadow)
         : shadow(shadow)
     {
+        BA_GUARD_RECORD(shadow, BAGuardOp_Destroy);
+        BA_GUARD_SCHEDULING_POINT(shadow);
         const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
-        if (BadAccessGuardShadow::GetState(lastSeenOp) != BAGuard_ReadingOrIdle) BA_GUARD_UNLIKELY
+        BA_GUARD_PROBE(guard_enter, shadow, BAGuard_DestructorCalled, lastSeenOp);
+        if (ShadowT::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY
         {
-            BAGuardHandleBadAccess(lastSeenOp, BAGuard_Writing);
+            BA_GUARD_PROBE(bad_access, shadow, BAGuard_Writing, lastSeenOp);
+            BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Writing);
         }
         shadow.SetStateAtomicRelaxed(BAGuard_DestructorCalled); // Always write
     }
 };
 
+// Not a scope guard: once frozen, the object may only be read (from any thread) until it is destroyed.
+// Any write afterwards is reported, whenever it happens, instead of only when it overlaps a read. The object stays frozen after such a report.
+// Reads check the same bit as before, so they do not get any slower.
+template<typename ShadowT>
+inline BA_GUARD_FORCE_INLINE void BadAccessGuardFreeze(ShadowT& shadow)
+{
+    BA_GUARD_RECORD(shadow, BAGuardOp_Freeze);
+    const StateAndStackAddr lastSeenOp = BA_GUARD_ATOMIC_RELAXED_LOAD_UPTR(shadow.stateAndInStackAddr);
+    BA_GUARD_PROBE(guard_enter, shadow, BAGuard_Frozen, lastSeenOp);
+    if (ShadowT::IsWritingOrDestroyed(lastSeenOp)) BA_GUARD_UNLIKELY // Freezing twice is fine
+    {
+        BA_GUARD_PROBE(bad_access, shadow, BAGuard_Frozen, lastSeenOp);
+        BAGuardHandleBadAccess(ShadowT::ToReportedOperation(lastSeenOp), BAGuard_Frozen);
+    }
+    shadow.SetStateAtomicRelaxed(BAGuard_Frozen);
+}
+
+// Guards are templated on the shadow type for BadAccessGuardSharedShadow, the macros pick the right one.
+using BadAccessGuardRead = BadAccessGuardReadT<BadAccessGuardShadow>;
+using BadAccessGuardWrite = BadAccessGuardWriteT<BadAccessGuardShadow>;
+using BadAccessGuardWriteEx = BadAccessGuardWriteExT<BadAccessGuardShadow>;
+using BadAccessGuardDestroy = BadAccessGuardDestroyT<BadAccessGuardShadow>;
+
 struct BadAccessGuardConfig
 {
     // Should we allow to break at all, or simply call `reportBadAccess`
@@ -235,7 +720,9 @@ struct BadAccessGuardConfig
     // If non-null, used to report errors instead of the default function.
     // Breaking is still controlled by `allowBreak` and `breakASAP`.
     // Returning false can prevent triggering the breakpoint (except if `breakASAP` is true)
-    using ReportBadAccessFunction = bool(StateAndStackAddr previousOperation, BadAccessGuardState toState, bool assertionOrWarning, const char* message);
+    // `site` describes the guard that detected the issue. Guards without a static site descriptor only fill `message` and `assertionOrWarning`.
+    // `backtrace` is the callstack of the thread that detected the issue, it may be empty if unsupported by the platform.
+    using ReportBadAccessFunction = bool(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace);
     ReportBadAccessFunction* reportBadAccess;
 };
 
@@ -243,23 +730,67 @@ struct BadAccessGuardConfig
 BadAccessGuardConfig BadAccessGuardGetConfig();
 void BadAccessGuardSetConfig(BadAccessGuardConfig config);
 
+// Suppression rules for known (and accepted) bad accesses. One rule per line or separated by `;`, `#` starts a comment:
+// - `site:<file name>:<line>`, `function:<name>`, `type:<name>`: match the static site descriptor of the guard, see `BA_GUARD_READ_SITE`. The file name is matched without its directory.
+// - `addr:<begin>-<end>`: hexadecimal, matches if one of the frames of the backtrace is in [begin, end).
+// If the library is built with `BA_GUARD_SUPPRESSIONS_FROM_ENV=1`, rules are also loaded on the first bad access from the `BAD_ACCESS_GUARDS_SUPPRESSIONS` environment variable, and from the file named by `BAD_ACCESS_GUARDS_SUPPRESSIONS_FILE`.
+// They are only looked up in the slow path. Suppressed bad accesses are counted, but neither reported nor break, unless `breakASAP` is set: it breaks before rules are looked up.
+// Invalid rules, and rules longer than 1023 characters, are reported as warnings and ignored.
+// Returns the number of rules added: a rule identical to an existing one is ignored, and neither uses a slot nor is counted. Not thread safe: add rules before guards may detect anything.
+int BadAccessGuardAddSuppressions(const char* rules);
+// Total number of bad accesses suppressed so far.
+uint64_t BadAccessGuardGetSuppressedCount();
+// Prints the rules and how many times they matched with `BadAccessGuardReport`.
+void BadAccessGuardDumpSuppressions();
+
+// Bulk audit, for frame or tick boundaries: checks that none of the `count` shadows is left writing or destroyed (an exception escaping a write guard, a use after free...),
+// or holds an invalid state (memory scribbled over, only detectable on Windows where the state takes a byte). Idle and frozen shadows are fine.
+// Shadow `i` is at `(const char*)firstShadow + i * stride`, for example `&objects[0].shadow` and `sizeof(objects[0])`.
+// Returns the number of offending shadows, and writes the indices of the first `maxIndices` of them to `outIndices`.
+// Uses SSE2/AVX2/NEON on 64 bits platforms when available (see `BA_GUARD_AUDIT_SIMD`), shadows are ORed per block and only blocks with an offending state are rescanned.
+// Shadows are read without atomics, so the result is only meaningful if no thread is using them.
+size_t BadAccessGuardAuditShadows(const BadAccessGuardShadow* firstShadow, size_t stride, size_t count, size_t* outIndices, size_t maxIndices);
+// Same, but reports the first `maxReported` offending shadows (index, state and stack address) with `BadAccessGuardReport` as a warning.
+size_t BadAccessGuardReportAudit(const BadAccessGuardShadow* firstShadow, size_t stride, size_t count, size_t maxReported);
+
 #define BA_GUARD_MERGE_NAME_(a,b) a##b
 #define BA_GUARD_MERGE_NAME(a,b) BA_GUARD_MERGE_NAME_(a,b)
 
+// Guards are instantiated for the type of the shadow, so that the same macros work with BadAccessGuardSharedShadow.
+#define BA_GUARD_SHADOW_TYPE(SHADOWNAME)                        typename BadAccessGuardShadowType<decltype(SHADOWNAME)>::type
+
 #define BA_GUARD_DECL(SHADOWNAME)                               mutable BadAccessGuardShadow SHADOWNAME
-#define BA_GUARD_READ(SHADOWNAME)                               BadAccessGuardRead BA_GUARD_MERGE_NAME(BAGuardRead_,__COUNTER__){SHADOWNAME}
-#define BA_GUARD_READ_EX(SHADOWNAME,ASSERT_OR_WARN,MESSAGE)     BadAccessGuardRead BA_GUARD_MERGE_NAME(BAGuardRead_,__COUNTER__){SHADOWNAME, (ASSERT_OR_WARN), (MESSAGE)}
-#define BA_GUARD_WRITE(SHADOWNAME)                              BadAccessGuardWrite BA_GUARD_MERGE_NAME(BAGuardWrite_,__COUNTER__){SHADOWNAME}
-#define BA_GUARD_WRITE_EX(SHADOWNAME,ASSERT_OR_WARN,MESSAGE)    BadAccessGuardWriteEx BA_GUARD_MERGE_NAME(BAGuardWriteEx_,__COUNTER__){SHADOWNAME, (ASSERT_OR_WARN), (MESSAGE)}
-#define BA_GUARD_DESTROY(SHADOWNAME)                            BadAccessGuardDestroy BA_GUARD_MERGE_NAME(BAGuardDestroy_,__COUNTER__){SHADOWNAME}
+#define BA_GUARD_SHARED_DECL(SHADOWNAME)                        mutable BadAccessGuardSharedShadow SHADOWNAME
+#define BA_GUARD_READ(SHADOWNAME)                               BadAccessGuardReadT<BA_GUARD_SHADOW_TYPE(SHADOWNAME)> BA_GUARD_MERGE_NAME(BAGuardRead_,__COUNTER__){SHADOWNAME}
+#define BA_GUARD_READ_EX(SHADOWNAME,ASSERT_OR_WARN,MESSAGE)     BadAccessGuardReadT<BA_GUARD_SHADOW_TYPE(SHADOWNAME)> BA_GUARD_MERGE_NAME(BAGuardRead_,__COUNTER__){SHADOWNAME, (ASSERT_OR_WARN), (MESSAGE)}
+#define BA_GUARD_WRITE(SHADOWNAME)                              BadAccessGuardWriteT<BA_GUARD_SHADOW_TYPE(SHADOWNAME)> BA_GUARD_MERGE_NAME(BAGuardWrite_,__COUNTER__){SHADOWNAME}
+#define BA_GUARD_WRITE_EX(SHADOWNAME,ASSERT_OR_WARN,MESSAGE)    BadAccessGuardWriteExT<BA_GUARD_SHADOW_TYPE(SHADOWNAME)> BA_GUARD_MERGE_NAME(BAGuardWriteEx_,__COUNTER__){SHADOWNAME, (ASSERT_OR_WARN), (MESSAGE)}
+#define BA_GUARD_DESTROY(SHADOWNAME)                            BadAccessGuardDestroyT<BA_GUARD_SHADOW_TYPE(SHADOWNAME)> BA_GUARD_MERGE_NAME(BAGuardDestroy_,__COUNTER__){SHADOWNAME}
+#define BA_GUARD_FREEZE(SHADOWNAME)                             BadAccessGuardFreeze(SHADOWNAME)
+// Reports the objects of `ARRAY[0..COUNT)` whose shadow is left writing, destroyed or corrupted.
+#define BA_GUARD_AUDIT_ARRAY(ARRAY,COUNT,SHADOWNAME)            BadAccessGuardReportAudit(&(ARRAY)[0].SHADOWNAME, sizeof((ARRAY)[0]), (COUNT), 16)
+
+// Those declare a `static constexpr BadAccessGuardSite` for the call site. TYPENAME is stringified, MESSAGE may be nullptr.
+#define BA_GUARD_READ_SITE(SHADOWNAME,TYPENAME,ASSERT_OR_WARN,MESSAGE)  BA_GUARD_SITE_GUARD_(BadAccessGuardReadSite, __COUNTER__, SHADOWNAME, TYPENAME, ASSERT_OR_WARN, MESSAGE)
+#define BA_GUARD_WRITE_SITE(SHADOWNAME,TYPENAME,ASSERT_OR_WARN,MESSAGE) BA_GUARD_SITE_GUARD_(BadAccessGuardWriteSite, __COUNTER__, SHADOWNAME, TYPENAME, ASSERT_OR_WARN, MESSAGE)
+// The descriptor is wrapped in a local type so that guards get its address as a template parameter instead of storing it.
+#define BA_GUARD_SITE_GUARD_(GUARDTYPE,ID,SHADOWNAME,TYPENAME,ASSERT_OR_WARN,MESSAGE) \
+    static constexpr BadAccessGuardSite BA_GUARD_MERGE_NAME(BAGuardSiteDesc_,ID){ __FILE__, __func__, #TYPENAME, (MESSAGE), __LINE__, (ASSERT_OR_WARN) }; \
+    struct BA_GUARD_MERGE_NAME(BAGuardSite_,ID) { static BA_GUARD_FORCE_INLINE const BadAccessGuardSite* Get() { return &BA_GUARD_MERGE_NAME(BAGuardSiteDesc_,ID); } }; \
+    GUARDTYPE<BA_GUARD_MERGE_NAME(BAGuardSite_,ID), BA_GUARD_SHADOW_TYPE(SHADOWNAME)> BA_GUARD_MERGE_NAME(BAGuardSiteGuard_,ID){SHADOWNAME}
 
 #else // BAD_ACCESS_GUARDS_ENABLE
 
 #define BA_GUARD_DECL(SHADOWNAME)
+#define BA_GUARD_SHARED_DECL(SHADOWNAME)
 #define BA_GUARD_READ(SHADOWNAME)                               do {} while(false)
 #define BA_GUARD_READ_EX(SHADOWNAME,ASSERT_OR_WARN,MESSAGE)     do {} while(false)
 #define BA_GUARD_WRITE(SHADOWNAME)                              do {} while(false)
 #define BA_GUARD_WRITE_EX(SHADOWNAME,ASSERT_OR_WARN,MESSAGE)    do {} while(false)
 #define BA_GUARD_DESTROY(SHADOWNAME)                            do {} while(false)
+#define BA_GUARD_FREEZE(SHADOWNAME)                             do {} while(false)
+#define BA_GUARD_AUDIT_ARRAY(ARRAY,COUNT,SHADOWNAME)            do {} while(false)
+#define BA_GUARD_READ_SITE(SHADOWNAME,TYPENAME,ASSERT_OR_WARN,MESSAGE)  do {} while(false)
+#define BA_GUARD_WRITE_SITE(SHADOWNAME,TYPENAME,ASSERT_OR_WARN,MESSAGE) do {} while(false)
 
 #endif // BAD_ACCESS_GUARDS_ENABLE
\ No newline at end of file
@@ -0,0 +1,222 @@
+﻿// BadAccessGuards v1.0.0 https://github.com/Lectem/BadAccessGuards
+
+#include "BadAccessGuardsExplorer.h"
+
+#if BAD_ACCESS_GUARDS_ENABLE
+
+#if !BAD_ACCESS_GUARDS_SCHEDULING_POINTS
+# error "The explorer needs BAD_ACCESS_GUARDS_SCHEDULING_POINTS=1, otherwise guards never give it the hand."
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct ExplorerChoice
+{
+    uint32_t choice;
+    uint32_t nbOptions;
+};
+
+// State of a single execution of the scenario.
+// Only the logical thread designated by `current` runs, the others wait on `wakeUp`. Passing the baton goes through `mutex`, which orders all their operations.
+struct ExplorerRun
+{
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    int current = -1;
+    std::vector<bool> finished;
+
+    // Choices to make first. Past its end, pick the first option (systematic) or a random one.
+    const std::vector<uint32_t>* prefix = nullptr;
+    bool randomAfterPrefix = false;
+    uint64_t rngState = 0;
+    std::vector<ExplorerChoice> choices;
+
+    int detections = 0;
+};
+
+ExplorerRun* gRun = nullptr;
+BadAccessGuardConfig::ReportBadAccessFunction* gPreviousReportBadAccess = nullptr;
+bool gReportDetections = false;
+thread_local int tLogicalThread = -1;
+
+uint64_t NextRandom(uint64_t& state)
+{
+    // splitmix64, good enough and gives different sequences for consecutive seeds
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Must be called with the mutex locked.
+// Candidates are ordered starting from `self` so that the first option never preempts the current thread.
+int PickNextThread(ExplorerRun& run, int self, bool includeSelf)
+{
+    const int nbThreads = int(run.finished.size());
+    std::vector<int> candidates;
+    for (int offset = 0; offset < nbThreads; offset++)
+    {
+        const int thread = (self + offset) % nbThreads;
+        if (!run.finished[thread] && (thread != self || includeSelf))
+        {
+            candidates.push_back(thread);
+        }
+    }
+    const uint32_t nbCandidates = uint32_t(candidates.size());
+
+    if (nbCandidates == 0) return -1;
+    if (nbCandidates == 1) return candidates[0]; // Not a choice, don't record it
+
+    const size_t step = run.choices.size();
+    uint32_t choice = 0;
+    if (run.prefix && step < run.prefix->size()) choice = (*run.prefix)[step] % nbCandidates;
+    else if (run.randomAfterPrefix) choice = uint32_t(NextRandom(run.rngState) % nbCandidates);
+    run.choices.push_back({ choice, nbCandidates });
+    return candidates[choice];
+}
+
+void ExplorerSchedulingPoint(const BadAccessGuardShadow&)
+{
+    const int self = tLogicalThread;
+    if (self < 0) return; // Not one of our logical threads
+
+    ExplorerRun& run = *gRun;
+    std::unique_lock<std::mutex> lock(run.mutex);
+    run.current = PickNextThread(run, self, true);
+    if (run.current != self)
+    {
+        run.wakeUp.notify_all();
+        run.wakeUp.wait(lock, [&] { return run.current == self; });
+    }
+}
+
+bool ExplorerReportBadAccess(StateAndStackAddr previousOperation, BadAccessGuardState toState, const BadAccessGuardSite& site, const BadAccessGuardBacktrace& backtrace)
+{
+    // Only the thread holding the baton can get here, no need to lock
+    gRun->detections++;
+    if (gReportDetections) gPreviousReportBadAccess(previousOperation, toState, site, backtrace);
+    return false;
+}
+
+void RunLogicalThread(ExplorerRun& run, int self, const std::function<void()>& function)
+{
+    tLogicalThread = self;
+    {
+        std::unique_lock<std::mutex> lock(run.mutex);
+        run.wakeUp.wait(lock, [&] { return run.current == self; });
+    }
+
+    function();
+
+    {
+        std::unique_lock<std::mutex> lock(run.mutex);
+        run.finished[self] = true;
+        run.current = PickNextThread(run, self, false);
+    }
+    run.wakeUp.notify_all();
+    tLogicalThread = -1;
+}
+
+void RunOnce(const BadAccessGuardExplorerScenario& scenario, ExplorerRun& run, bool reportDetections)
+{
+    const BadAccessGuardExplorerThreads functions = scenario();
+    run.finished.assign(functions.size(), false);
+
+    // Count detections instead of breaking
+    const BadAccessGuardConfig previousConfig = BadAccessGuardGetConfig();
+    BadAccessGuardConfig config = previousConfig;
+    config.allowBreak = false;
+    config.reportBadAccess = ExplorerReportBadAccess;
+    gPreviousReportBadAccess = previousConfig.reportBadAccess;
+    gReportDetections = reportDetections;
+    gRun = &run;
+    BadAccessGuardSetConfig(config);
+    BadAccessGuardSetSchedulingPointHook(ExplorerSchedulingPoint);
+
+    std::vector<std::thread> threads;
+    threads.reserve(functions.size());
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        threads.emplace_back(RunLogicalThread, std::ref(run), int(i), std::cref(functions[i]));
+    }
+    {
+        std::unique_lock<std::mutex> lock(run.mutex);
+        run.current = PickNextThread(run, 0, true);
+    }
+    run.wakeUp.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    BadAccessGuardSetSchedulingPointHook(nullptr);
+    BadAccessGuardSetConfig(previousConfig);
+    gRun = nullptr;
+}
+
+std::vector<uint32_t> ToSchedule(const std::vector<ExplorerChoice>& choices)
+{
+    std::vector<uint32_t> schedule;
+    schedule.reserve(choices.size());
+    for (const ExplorerChoice& choice : choices) schedule.push_back(choice.choice);
+    return schedule;
+}
+
+} // namespace
+
+BadAccessGuardExplorerResult BadAccessGuardExplore(const BadAccessGuardExplorerScenario& scenario, const BadAccessGuardExplorerOptions& options)
+{
+    BadAccessGuardExplorerResult result;
+    std::vector<uint32_t> systematicPrefix;
+    for (int iteration = 0; iteration < options.maxIterations; iteration++)
+    {
+        ExplorerRun run;
+        run.prefix = options.systematic ? &systematicPrefix : nullptr;
+        run.randomAfterPrefix = !options.systematic;
+        run.rngState = options.seed + uint64_t(iteration);
+        RunOnce(scenario, run, options.reportDetections);
+        result.iterations++;
+
+        if (run.detections > 0)
+        {
+            if (result.detections == 0)
+            {
+                result.failingSeed = options.seed + uint64_t(iteration);
+                result.failingSchedule = ToSchedule(run.choices);
+            }
+            result.detections++;
+            if (options.stopOnFirstDetection) break;
+        }
+
+        if (options.systematic)
+        {
+            // Depth-first: change the deepest choice that still has options left, the remaining ones will default to 0.
+            while (!run.choices.empty() && run.choices.back().choice + 1 >= run.choices.back().nbOptions)
+            {
+                run.choices.pop_back();
+            }
+            if (run.choices.empty())
+            {
+                result.exhausted = true;
+                break;
+            }
+            run.choices.back().choice++;
+            systematicPrefix = ToSchedule(run.choices);
+        }
+    }
+    return result;
+}
+
+bool BadAccessGuardExplorerReplay(const BadAccessGuardExplorerScenario& scenario, const std::vector<uint32_t>& schedule)
+{
+    ExplorerRun run;
+    run.prefix = &schedule;
+    RunOnce(scenario, run, true);
+    return run.detections > 0;
+}
+
+#endif
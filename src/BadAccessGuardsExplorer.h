@@ -0,0 +1,64 @@
+﻿// BadAccessGuards v1.0.0 https://github.com/Lectem/BadAccessGuards
+#pragma once
+
+// Test mode only: deterministic exploration of thread interleavings.
+//
+// Instead of running a scenario many times and hoping the OS schedules threads in a way that triggers the race,
+// the explorer runs its logical threads one at a time and uses the guards as preemption points.
+// At each guard (see `BA_GUARD_SCHEDULING_POINT`), it picks which thread runs next, either at random or systematically.
+// A race that would need hours of stress testing is then found in a few iterations, and can be replayed from its seed or schedule.
+//
+// Requires `BAD_ACCESS_GUARDS_SCHEDULING_POINTS=1` for all the code using guards, and uses the C++ standard library.
+// Limitations:
+// - Logical threads must not block waiting for each other (locks, condition variables, joins...), since only one of them runs at a time.
+// - Only guarded operations are preemption points. This is enough to detect what the guards can detect.
+
+#include "BadAccessGuards.h"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+using BadAccessGuardExplorerThreads = std::vector<std::function<void()>>;
+// Called before each iteration, must return the functions of the logical threads. They should not share state with previous iterations.
+using BadAccessGuardExplorerScenario = std::function<BadAccessGuardExplorerThreads()>;
+
+struct BadAccessGuardExplorerOptions
+{
+    // Random mode: iteration `i` uses the seed `seed + i`.
+    uint64_t seed = 1;
+    int maxIterations = 1000;
+    // Enumerate schedules in order (depth-first, non-preemptive schedules first) instead of picking them at random.
+    bool systematic = false;
+    bool stopOnFirstDetection = true;
+    // Report detections with `BadAccessGuardConfig::reportBadAccess`. Disabled by default to avoid flooding the logs, replay the schedule instead.
+    bool reportDetections = false;
+};
+
+struct BadAccessGuardExplorerResult
+{
+    int iterations = 0;
+    // Number of iterations during which at least one bad access was detected
+    int detections = 0;
+    // Systematic mode: every schedule was explored
+    bool exhausted = false;
+    // First detection, if any. Random mode: replay with `seed = failingSeed` and `maxIterations = 1`.
+    uint64_t failingSeed = 0;
+    // First detection, if any. Index of the thread picked among the runnable ones at each preemption point, for `BadAccessGuardExplorerReplay`.
+    std::vector<uint32_t> failingSchedule;
+};
+
+#if BAD_ACCESS_GUARDS_ENABLE
+
+BadAccessGuardExplorerResult BadAccessGuardExplore(const BadAccessGuardExplorerScenario& scenario, const BadAccessGuardExplorerOptions& options);
+
+// Runs the scenario once with the given schedule, reporting detections. Returns true if a bad access was detected.
+bool BadAccessGuardExplorerReplay(const BadAccessGuardExplorerScenario& scenario, const std::vector<uint32_t>& schedule);
+
+#else // BAD_ACCESS_GUARDS_ENABLE
+
+// Guards can not detect anything, so there is nothing to explore: scenarios are not run.
+inline BadAccessGuardExplorerResult BadAccessGuardExplore(const BadAccessGuardExplorerScenario&, const BadAccessGuardExplorerOptions&) { return BadAccessGuardExplorerResult{}; }
+inline bool BadAccessGuardExplorerReplay(const BadAccessGuardExplorerScenario&, const std::vector<uint32_t>&) { return false; }
+
+#endif // BAD_ACCESS_GUARDS_ENABLE